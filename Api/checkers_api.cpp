@@ -0,0 +1,213 @@
+// Разделяемая библиотека движка: g++ -std=c++17 -O2 -shared -fPIC -fvisibility=hidden
+// -DCHECKERS_API_BUILD Api/checkers_api.cpp -o libcheckers.so (нужны те же заголовки, что и игре)
+#include <memory>
+#include <mutex>
+
+#include "../Game/Board.h"
+#include "../Game/Config.h"
+#include "../Game/Logic.h"
+#include "../Game/Notation.h"
+#include "checkers_api.h"
+
+struct checkers_engine
+{
+    explicit checkers_engine(const string &settings_path) : config(settings_path)
+    {
+        reset_logic();
+    }
+
+    // Логика читает настройки в конструкторе, поэтому после их замены создаётся заново
+    void reset_logic()
+    {
+        logic = make_unique<Logic>(nullptr, &config);
+    }
+
+    Config config;
+    unique_ptr<Logic> logic;
+    mutex mtx; // вызовы одного движка идут по очереди
+    vector<vector<POS_T>> board = Logic::start_mtx(); // доска для распаковки позиций, без выделений на вызов
+};
+
+namespace
+{
+const int Squares = Russian_rules::Squares;
+
+// Поле k упакованной позиции
+void square_coords(const int k, POS_T &x, POS_T &y)
+{
+    x = POS_T(k / 4);
+    y = POS_T(2 * (k % 4) + (x % 2 == 0 ? 1 : 0));
+}
+
+// Распаковка позиции в доску движка, false - позиция неверна
+bool unpack(const checkers_position &pos, vector<vector<POS_T>> &mtx)
+{
+    if ((pos.white & pos.black) != 0 || (pos.kings & ~(pos.white | pos.black)) != 0 || pos.side > 1)
+        return false;
+    for (auto &row : mtx)
+        fill(row.begin(), row.end(), POS_T(0));
+    for (int k = 0; k < Squares; ++k)
+    {
+        const uint32_t bit = 1u << k;
+        if (!((pos.white | pos.black) & bit))
+            continue;
+        POS_T x, y;
+        square_coords(k, x, y);
+        mtx[x][y] = POS_T(((pos.white & bit) ? 1 : 2) + ((pos.kings & bit) ? 2 : 0));
+    }
+    return true;
+}
+
+// Полный ход движка (серия ударов) в упакованный
+void pack_move(const vector<move_pos> &turn, checkers_move &res)
+{
+    res.captured = 0;
+    res.length = 0;
+    if (turn.empty())
+        return;
+    res.path[res.length++] = uint8_t(Russian_rules::index(turn[0].x, turn[0].y));
+    for (auto &step : turn)
+    {
+        if (res.length < CHECKERS_MAX_PATH)
+            res.path[res.length++] = uint8_t(Russian_rules::index(step.x2, step.y2));
+        if (step.xb != -1)
+            res.captured |= 1u << Russian_rules::index(step.xb, step.yb);
+    }
+}
+
+// Тело вызова под замком движка: исключения не выходят за границу C
+template <class F> int guarded(checkers_engine *engine, F &&body)
+{
+    if (!engine)
+        return CHECKERS_ERROR_ARGUMENT;
+    try
+    {
+        lock_guard<mutex> lock(engine->mtx);
+        return body();
+    }
+    catch (...)
+    {
+        return CHECKERS_ERROR_INTERNAL;
+    }
+}
+} // namespace
+
+extern "C" {
+
+CHECKERS_API int checkers_api_version(void)
+{
+    return CHECKERS_API_VERSION;
+}
+
+CHECKERS_API checkers_engine *checkers_engine_new(const char *settings_path)
+{
+    try
+    {
+        return new checkers_engine(settings_path ? string(settings_path) : project_path + "settings.json");
+    }
+    catch (...)
+    {
+        return nullptr; // нет файла настроек или в нём ошибка
+    }
+}
+
+CHECKERS_API void checkers_engine_free(checkers_engine *engine)
+{
+    delete engine;
+}
+
+CHECKERS_API int checkers_engine_set_option(checkers_engine *engine, const char *section, const char *name,
+                                            const char *json_value)
+{
+    if (!section || !name || !json_value)
+        return CHECKERS_ERROR_ARGUMENT;
+    return guarded(engine, [&]() {
+        const json value = json::parse(json_value, nullptr, false);
+        if (value.is_discarded())
+            return CHECKERS_ERROR_ARGUMENT;
+        engine->config.set(section, name, value);
+        engine->reset_logic();
+        return CHECKERS_OK;
+    });
+}
+
+CHECKERS_API int checkers_engine_clear(checkers_engine *engine)
+{
+    return guarded(engine, [&]() {
+        engine->logic->clear_tables();
+        return CHECKERS_OK;
+    });
+}
+
+CHECKERS_API int checkers_legal_moves(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                      checkers_move *moves, size_t capacity, uint32_t *offsets, size_t *required)
+{
+    if ((count && !positions) || !offsets || (capacity && !moves))
+        return CHECKERS_ERROR_ARGUMENT;
+    return guarded(engine, [&]() {
+        size_t total = 0;
+        bool fits = true;
+        offsets[0] = 0;
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (!unpack(positions[k], engine->board))
+                return CHECKERS_ERROR_POSITION;
+            auto turns = Notation::legal_turns(*engine->logic, engine->board, positions[k].side != 0);
+            if (fits && total + turns.size() <= capacity)
+            {
+                for (size_t t = 0; t < turns.size(); ++t)
+                    pack_move(turns[t], moves[total + t]);
+                offsets[k + 1] = uint32_t(total + turns.size());
+            }
+            else
+            {
+                fits = false; // дальше только считаем, сколько места нужно
+            }
+            total += turns.size();
+        }
+        if (required)
+            *required = total;
+        return fits ? CHECKERS_OK : CHECKERS_ERROR_BUFFER;
+    });
+}
+
+CHECKERS_API int checkers_evaluate(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                   double *scores)
+{
+    if (count && (!positions || !scores))
+        return CHECKERS_ERROR_ARGUMENT;
+    return guarded(engine, [&]() {
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (!unpack(positions[k], engine->board))
+                return CHECKERS_ERROR_POSITION;
+            scores[k] = engine->logic->evaluate(engine->board, positions[k].side != 0);
+        }
+        return CHECKERS_OK;
+    });
+}
+
+CHECKERS_API int checkers_best_moves(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                     int depth, checkers_move *moves, double *scores, uint64_t *nodes)
+{
+    if ((count && (!positions || !moves)) || depth < 0 || depth > Max_iterate_depth)
+        return CHECKERS_ERROR_ARGUMENT;
+    return guarded(engine, [&]() {
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (!unpack(positions[k], engine->board))
+                return CHECKERS_ERROR_POSITION;
+            Logic &logic = *engine->logic;
+            logic.Max_depth = depth;
+            auto lines = logic.analyse(engine->board, positions[k].side != 0, 1);
+            pack_move(lines.empty() ? vector<move_pos>() : lines[0].turns, moves[k]);
+            if (scores)
+                scores[k] = lines.empty() ? 0 : lines[0].score;
+            if (nodes)
+                nodes[k] = logic.get_nodes();
+        }
+        return CHECKERS_OK;
+    });
+}
+
+} // extern "C"
@@ -0,0 +1,89 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Интерфейс движка на C для других языков (Python ctypes/cffi, Go cgo): разделяемая библиотека
+ * из checkers_api.cpp. Русские шашки 8x8. Все вызовы пакетные: позиции и результаты лежат в массивах
+ * вызывающей стороны, библиотека их не выделяет и не хранит. Движок (checkers_engine) держит свою
+ * логику с хеш-таблицей, историей и решателем между вызовами; вызовы одного движка из разных потоков
+ * выполняются по очереди, разные движки работают параллельно. Двоичный интерфейс меняется только
+ * с номером CHECKERS_API_VERSION */
+
+#ifdef _WIN32
+#ifdef CHECKERS_API_BUILD
+#define CHECKERS_API __declspec(dllexport)
+#else
+#define CHECKERS_API __declspec(dllimport)
+#endif
+#else
+#define CHECKERS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHECKERS_API_VERSION 1
+#define CHECKERS_MAX_PATH 16 /* полей в пути одного хода: начальное, места приземления и конечное */
+
+/* Коды возврата */
+#define CHECKERS_OK 0
+#define CHECKERS_ERROR_ARGUMENT (-1) /* нулевой указатель или неверный параметр */
+#define CHECKERS_ERROR_POSITION (-2) /* в позиции поле занято двумя цветами или дамка без фигуры */
+#define CHECKERS_ERROR_BUFFER (-3)   /* не хватило места в массиве ходов */
+#define CHECKERS_ERROR_INTERNAL (-4) /* исключение внутри движка */
+
+/* Позиция по 32 тёмным полям: бит k - поле строки k / 4 (строка 0 - восьмая горизонталь, откуда
+ * начинают черные), столбца 2 * (k % 4) + 1 в чётных строках и 2 * (k % 4) в нечётных, как в строке
+ * позиции протокола движка. Белые ходят к строке 0 */
+typedef struct checkers_position
+{
+    uint32_t white; /* фигуры белых */
+    uint32_t black; /* фигуры черных */
+    uint32_t kings; /* какие из фигур - дамки */
+    uint32_t side;  /* ходящая сторона: 0 - белые, 1 - черные */
+} checkers_position;
+
+/* Полный ход: серия ударов - один ход с путём через все места приземления */
+typedef struct checkers_move
+{
+    uint32_t captured;               /* поля побитых фигур */
+    uint8_t length;                  /* полей в path: 2 - тихий ход или один удар */
+    uint8_t path[CHECKERS_MAX_PATH]; /* номера полей: начальное, ..., конечное */
+} checkers_move;
+
+typedef struct checkers_engine checkers_engine;
+
+CHECKERS_API int checkers_api_version(void);
+
+/* Движок с настройками из файла settings_path (NULL - settings.json рабочей папки), NULL - ошибка */
+CHECKERS_API checkers_engine *checkers_engine_new(const char *settings_path);
+CHECKERS_API void checkers_engine_free(checkers_engine *engine);
+
+/* Замена настройки section.name значением json_value (текст JSON, например "\"O2\"" или "8").
+ * Логика движка создаётся заново, таблицы очищаются */
+CHECKERS_API int checkers_engine_set_option(checkers_engine *engine, const char *section, const char *name,
+                                            const char *json_value);
+
+/* Очистка хеш-таблицы, истории и таблицы решателя (новая партия) */
+CHECKERS_API int checkers_engine_clear(checkers_engine *engine);
+
+/* Допустимые ходы count позиций: ходы позиции k - moves[offsets[k]] ... moves[offsets[k + 1] - 1],
+ * в offsets - count + 1 элементов. При нехватке места (CHECKERS_ERROR_BUFFER) offsets заполнены для
+ * поместившихся позиций, в *required - сколько ходов нужно всего */
+CHECKERS_API int checkers_legal_moves(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                      checkers_move *moves, size_t capacity, uint32_t *offsets, size_t *required);
+
+/* Статическая оценка (функция оценки бота без поиска) с точки зрения ходящей стороны:
+ * отношение материала, 1e9 - выигрыш, 0 - проигрыш */
+CHECKERS_API int checkers_evaluate(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                   double *scores);
+
+/* Лучший ход каждой позиции поиском на глубину depth (уровень бота). scores и nodes могут быть NULL.
+ * У позиции без ходов length хода равен 0, а оценка - 0 */
+CHECKERS_API int checkers_best_moves(checkers_engine *engine, const checkers_position *positions, size_t count,
+                                     int depth, checkers_move *moves, double *scores, uint64_t *nodes);
+
+#ifdef __cplusplus
+}
+#endif
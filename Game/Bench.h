@@ -0,0 +1,385 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Engine_protocol.h"
+#include "Logic.h"
+#include "Time_manager.h"
+
+// Микробенчмарки движка на фиксированном наборе позиций (режим "Checkers bench")
+class Bench
+{
+public:
+    Bench(Config *config) : config(config)
+    {
+    }
+
+    // what - "eval", "search", "international", "mcts", "network", "rules", "protocol" или пустая строка
+    // (всё). 1 - проверка правил или протокола не прошла
+    int run(const string &what = "")
+    {
+        bool ok = true;
+        if (what.empty() || what == "eval")
+            eval();
+        if (what.empty() || what == "search")
+            search();
+        if (what.empty() || what == "international")
+            international();
+        if (what.empty() || what == "mcts")
+            mcts();
+        if (what.empty() || what == "network")
+            network();
+        if (what.empty() || what == "rules")
+            ok = series_promotion<Logic>("8x8") && series_promotion<International_logic>("10x10");
+        if (what.empty() || what == "protocol")
+            ok = protocol() && ok;
+        return ok ? 0 : 1;
+    }
+
+    // Набор позиций из случайных партий с фиксированным зерном: одинаков при каждом запуске.
+    // L - логика варианта (Logic - русские шашки, International_logic - международные)
+    template <class L = Logic>
+    vector<pair<vector<vector<POS_T>>, bool>> positions(const size_t count, const unsigned seed = 1) const
+    {
+        L logic(nullptr, config);
+        logic.set_seed(seed);
+        default_random_engine rand_eng(seed);
+        vector<pair<vector<vector<POS_T>>, bool>> res;
+        while (res.size() < count)
+        {
+            auto mtx = L::start_mtx();
+            for (int turn_num = 0; turn_num < Max_random_plies && res.size() < count; ++turn_num)
+            {
+                const bool color = turn_num % 2;
+                logic.find_turns(color, mtx);
+                if (logic.turns.empty())
+                    break;
+                res.emplace_back(mtx, color);
+                while (true)
+                {
+                    auto turn = logic.turns[rand_eng() % logic.turns.size()];
+                    mtx = logic.make_turn(mtx, turn);
+                    if (turn.xb == -1)
+                        break;
+                    logic.find_turns(turn.x2, turn.y2, mtx);
+                    if (!logic.have_beats)
+                    {
+                        logic.finish_series(mtx, turn);
+                        break;
+                    }
+                }
+            }
+        }
+        return res;
+    }
+
+    // Оценка листьев: по одному (make_turn + calc_score) против пачки Leaf_batch
+    void eval()
+    {
+        Logic logic(nullptr, config);
+        // Листья узлов перед горизонтом - тихие ходы, их и берём
+        vector<pair<vector<vector<POS_T>>, vector<move_pos>>> frontier;
+        for (auto &pos : positions(Eval_positions))
+        {
+            logic.find_turns(pos.second, pos.first);
+            if (!logic.have_beats && !logic.turns.empty())
+                frontier.emplace_back(pos.first, logic.turns);
+        }
+        size_t leaves = 0;
+        for (auto &node : frontier)
+            leaves += node.second.size();
+
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        for (string mode : {"NumberOnly", "NumberAndPotential"})
+        {
+            logic.set_scoring_mode(mode);
+            double rate[2];
+            double check[2] = {0, 0}; // контрольные суммы: оба пути обязаны совпасть
+            for (int batched = 0; batched < 2; ++batched)
+            {
+                vector<double> scores;
+                auto start = chrono::steady_clock::now();
+                for (int rep = 0; rep < Eval_repeats; ++rep)
+                {
+                    for (auto &node : frontier)
+                    {
+                        logic.evaluate_leaves(node.first, node.second, rep % 2, scores, batched);
+                        check[batched] += scores[0];
+                    }
+                }
+                double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                rate[batched] = leaves * double(Eval_repeats) / max(sec, 1e-9);
+            }
+            cout << "Leaf eval " << mode << ": per-leaf " << int(rate[0]) << " leaves/sec, batched " << int(rate[1])
+                 << " leaves/sec, x" << rate[1] / rate[0] << (check[0] == check[1] ? "" : " MISMATCH") << "\n";
+            fout << "Bench leaf eval " << mode << ": per-leaf " << int(rate[0]) << " leaves/sec, batched "
+                 << int(rate[1]) << " leaves/sec\n";
+        }
+        fout.close();
+    }
+
+    // Поиск на уровнях Search_levels по набору позиций: узлы, время и сумма оценок лучших ходов
+    // (при одинаковой сумме поиск выбирает ходы той же силы). Выборочный поиск O2 сравнивается
+    // с полным альфа-бета O1 той же глубины: сколько узлов сэкономлено и в скольких позициях ход O2
+    // по точной оценке O1 не хуже лучшего (равных по силе ходов бывает несколько)
+    void search()
+    {
+        Logic logic(nullptr, config);
+        auto set = positions(Search_positions, 2);
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        for (int level : Search_levels)
+        {
+            logic.Max_depth = level;
+            // Точные оценки всех ходов корня полным поиском
+            logic.set_optimization("O1");
+            vector<vector<analysis_line>> exact;
+            for (auto &pos : set)
+            {
+                logic.clear_tables();
+                exact.push_back(logic.analyse(pos.first, pos.second, numeric_limits<size_t>::max()));
+            }
+            for (string mode : {"O1", "O2"})
+            {
+                logic.set_optimization(mode);
+                size_t nodes = 0, best_moves = 0;
+                double score_sum = 0;
+                auto start = chrono::steady_clock::now();
+                for (size_t k = 0; k < set.size(); ++k)
+                {
+                    logic.clear_tables();
+                    logic.set_seed(unsigned(k)); // одинаковый порядок ходов в обоих режимах
+                    auto turns = logic.find_best_turns(set[k].first, set[k].second);
+                    nodes += logic.get_nodes();
+                    score_sum += min(logic.last_score, 100.0); // выигрыш не перевешивает остальные позиции
+                    for (auto &line : exact[k])
+                        best_moves += (line.turns == turns && line.score >= exact[k][0].score);
+                }
+                int ms = int(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+                cout << "Search " << mode << " level " << level << ": " << nodes << " nodes, " << ms
+                     << " millisec, score sum " << score_sum << ", best move " << best_moves << "/" << set.size()
+                     << "\n";
+                fout << "Bench search " << mode << " level " << level << ": " << nodes << " nodes, " << ms
+                     << " millisec, best move " << best_moves << "/" << set.size() << "\n";
+            }
+        }
+        fout.close();
+    }
+
+    // Скорость поиска на доске 10x10 против 8x8 на одинаковых уровнях: узлы, время, узлов в секунду
+    void international()
+    {
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        for (int level : Variant_levels)
+        {
+            variant_search<Logic>("8x8", level, fout);
+            variant_search<International_logic>("10x10", level, fout);
+        }
+        fout.close();
+    }
+
+    // MCTS (секция "Mcts") на том же наборе позиций: доигровок в секунду и в скольких позициях его ход
+    // по точной оценке O1 уровня Mcts_level не хуже лучшего
+    void mcts()
+    {
+        Logic logic(nullptr, config);
+        auto set = positions(Search_positions, 2);
+        logic.Max_depth = Mcts_level;
+        logic.set_optimization("O1");
+        vector<vector<analysis_line>> exact;
+        for (auto &pos : set)
+        {
+            logic.clear_tables();
+            exact.push_back(logic.analyse(pos.first, pos.second, numeric_limits<size_t>::max()));
+        }
+        logic.set_engine("MCTS");
+        size_t playouts = 0, best_moves = 0;
+        double ms = 0;
+        for (size_t k = 0; k < set.size(); ++k)
+        {
+            logic.clear_tables();
+            auto turns = logic.find_best_turns(set[k].first, set[k].second);
+            playouts += logic.get_mcts_info().playouts;
+            ms += logic.get_mcts_info().ms;
+            for (auto &line : exact[k])
+                best_moves += (line.turns == turns && line.score >= exact[k][0].score);
+        }
+        cout << "MCTS: " << playouts << " playouts, " << int(ms) << " millisec, "
+             << size_t(playouts / max(ms / 1000, 1e-9)) << " playouts/sec, best move (O1 level " << Mcts_level
+             << ") " << best_moves << "/" << set.size() << "\n";
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        fout << "Bench MCTS: " << playouts << " playouts, " << int(ms) << " millisec, best move " << best_moves << "/"
+             << set.size() << "\n";
+    }
+
+    // Скорость поиска с сетью (Bot.NetworkFile) против оценки по отношению материала
+    // "NumberAndPotential" на одних уровнях: узлы, время, узлов в секунду и их отношение
+    void network()
+    {
+        Config net_config(*config);
+        net_config.set("Bot", "BotScoringType", "Network");
+        {
+            Logic check(nullptr, &net_config);
+            if (!check.uses_network())
+            {
+                cout << "Network: can't load " << string((*config)("Bot", "NetworkFile")) << "\n";
+                return;
+            }
+        }
+        Config ratio_config(*config);
+        ratio_config.set("Bot", "BotScoringType", "NumberAndPotential");
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        for (int level : Network_levels)
+        {
+            const double ratio_nps = network_search(ratio_config, "NumberAndPotential", level, fout);
+            const double net_nps = network_search(net_config, "Network", level, fout);
+            cout << "Network level " << level << ": x" << net_nps / max(ratio_nps, 1e-9)
+                 << " nodes/sec of NumberAndPotential\n";
+        }
+    }
+
+    // Удар на последнюю строку: белая шашка (2, 1) бьёт черную (1, 2) и встаёт на (0, 3). После конца
+    // серии (finish_series) это дамка и у белых есть ходы - и там, где шашка превращается посреди
+    // серии, и там, где только в конце
+    template <class L> bool series_promotion(const string &name) const
+    {
+        L logic(nullptr, config);
+        auto mtx = L::start_mtx();
+        for (auto &row : mtx)
+            fill(row.begin(), row.end(), POS_T(0));
+        mtx[2][1] = 1;
+        mtx[1][2] = 2;
+        logic.find_turns(0, mtx);
+        bool ok = logic.turns.size() == 1 && logic.turns[0].x2 == 0 && logic.turns[0].y2 == 3;
+        if (ok)
+        {
+            const move_pos turn = logic.turns[0];
+            mtx = logic.make_turn(mtx, turn);
+            logic.find_turns(turn.x2, turn.y2, mtx);
+            ok = !logic.have_beats;
+            logic.finish_series(mtx, turn);
+            logic.find_turns(0, mtx);
+            ok = ok && mtx[0][3] == 3 && !logic.turns.empty();
+        }
+        cout << "Rules " << name << ": capture onto the last row " << (ok ? "promotes" : "does not promote")
+             << "\n";
+        return ok;
+    }
+
+    // Протокол движка по часам: bestmove после "go wtime" и после "go ponder wtime" + ponderhit
+    // приходит не позже жёсткого предела хода Time_manager (с запасом на потоки)
+    bool protocol()
+    {
+        const double clock_ms = Protocol_clock_ms;
+        const string go = "go wtime " + to_string(int(clock_ms)) + " btime " + to_string(int(clock_ms));
+        Logic logic(nullptr, config);
+        Time_manager time;
+        time.start(clock_ms, 0, 0, (*config)("Clock", "MoveOverheadMS"),
+                   Notation::legal_turns(logic, Logic::start_mtx(), 0).size(), 0);
+        const double budget = time.hard_ms() + Protocol_slack_ms;
+
+        mutex mtx;
+        condition_variable cv;
+        bool has_bestmove = false;
+        Engine_protocol engine(config, [&](const string &line) {
+            if (line.compare(0, 8, "bestmove") != 0)
+                return;
+            lock_guard<mutex> lock(mtx);
+            has_bestmove = true;
+            cv.notify_all();
+        });
+        // Время от команды start_command до bestmove, мс (предел ожидания - 10 бюджетов)
+        auto measure = [&](const string &start_command) {
+            {
+                lock_guard<mutex> lock(mtx);
+                has_bestmove = false;
+            }
+            auto start = chrono::steady_clock::now();
+            engine.command(start_command);
+            unique_lock<mutex> lock(mtx);
+            cv.wait_for(lock, chrono::duration<double, milli>(budget * 10), [&]() { return has_bestmove; });
+            return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        };
+        engine.command("position startpos");
+        const double go_ms = measure(go);
+        engine.command("position startpos");
+        engine.command(go + " ponder");
+        this_thread::sleep_for(chrono::milliseconds(Ponder_ms));
+        const double ponderhit_ms = measure("ponderhit");
+        engine.command("stop");
+
+        const bool ok = go_ms <= budget && ponderhit_ms <= budget;
+        cout << "Protocol clock " << int(clock_ms) << " ms: go " << int(go_ms) << " millisec, ponderhit "
+             << int(ponderhit_ms) << " millisec, budget " << int(budget) << " millisec" << (ok ? "" : " FAILED")
+             << "\n";
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        fout << "Bench protocol: go " << int(go_ms) << " millisec, ponderhit " << int(ponderhit_ms)
+             << " millisec, budget " << int(budget) << " millisec" << (ok ? "" : " FAILED") << "\n";
+        return ok;
+    }
+
+private:
+    template <class L> void variant_search(const string &name, const int level, ofstream &fout)
+    {
+        L logic(nullptr, config);
+        logic.Max_depth = level;
+        auto set = positions<L>(Search_positions, 2);
+        size_t nodes = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t k = 0; k < set.size(); ++k)
+        {
+            logic.clear_tables();
+            logic.set_seed(unsigned(k));
+            logic.find_best_turns(set[k].first, set[k].second);
+            nodes += logic.get_nodes();
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Search " << name << " level " << level << ": " << nodes << " nodes, " << int(sec * 1000)
+             << " millisec, " << size_t(nodes / max(sec, 1e-9)) << " nodes/sec\n";
+        fout << "Bench search " << name << " level " << level << ": " << nodes << " nodes, " << int(sec * 1000)
+             << " millisec\n";
+    }
+
+    // Поиск уровня level по набору позиций, возвращает узлов в секунду
+    double network_search(Config &mode_config, const string &mode, const int level, ofstream &fout)
+    {
+        Logic logic(nullptr, &mode_config);
+        logic.Max_depth = level;
+        auto set = positions(Search_positions, 2);
+        size_t nodes = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t k = 0; k < set.size(); ++k)
+        {
+            logic.clear_tables();
+            logic.set_seed(unsigned(k));
+            logic.find_best_turns(set[k].first, set[k].second);
+            nodes += logic.get_nodes();
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const double nps = nodes / max(sec, 1e-9);
+        cout << "Search " << mode << " level " << level << ": " << nodes << " nodes, " << int(sec * 1000)
+             << " millisec, " << size_t(nps) << " nodes/sec\n";
+        fout << "Bench search " << mode << " level " << level << ": " << nodes << " nodes, " << int(sec * 1000)
+             << " millisec\n";
+        return nps;
+    }
+
+    const int Max_random_plies = 60; // длина случайной партии для набора позиций
+    const double Protocol_clock_ms = 1000; // часы обеих сторон в проверке протокола
+    const double Protocol_slack_ms = 50; // запас на пробуждение потоков сверх жёсткого предела
+    const int Ponder_ms = 300; // обдумывание до ponderhit
+    const size_t Eval_positions = 2000;
+    const int Eval_repeats = 20;
+    const size_t Search_positions = 40;
+    const vector<int> Search_levels = {6, 8, 10, 12};
+    const vector<int> Variant_levels = {4, 6, 8};
+    const int Mcts_level = 8; // глубина точных оценок для сравнения с MCTS
+    const vector<int> Network_levels = {6, 8};
+    Config *config; // указатель на Config
+};
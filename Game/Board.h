@@ -5,6 +5,8 @@
 
 #include "../Models/Move.h"
 #include "../Models/Project_path.h"
+#include "Rules.h"
+#include "Trace.h"
 
 #ifdef __APPLE__
 #include <SDL2/SDL.h>
@@ -16,8 +18,11 @@
 
 using namespace std;
 
+// Доска окна: русские шашки 8x8
 class Board
 {
+    using Rules = Russian_rules;
+
 public:
     Board() = default;
     // Конструктор доски с заданной шириной и высотой
@@ -84,6 +89,7 @@ public:
         history_mtx.clear();
         history_beat_series.clear();
         make_start_mtx();
+        set_title("Checkers");
         clear_active();
         clear_highlight();
     }
@@ -109,7 +115,7 @@ public:
         {
             throw runtime_error("begin position is empty, can't move");
         }
-        if ((mtx[i][j] == 1 && i2 == 0) || (mtx[i][j] == 2 && i2 == 7))
+        if (i2 == Rules::Promotion_row[mtx[i][j]])
             mtx[i][j] += 2;
         mtx[i2][j2] = mtx[i][j];
         drop_piece(i, j); // Удаление фигуры с начальной позиции
@@ -137,6 +143,12 @@ public:
         return mtx; // Возвращает текущее состояние доски
     }
 
+    // Начальная расстановка фигур (используется и без окна, например в самоигре)
+    static vector<vector<POS_T>> start_mtx()
+    {
+        return Rules::start_mtx();
+    }
+
     // Выделение заданных клеток на доске
     void highlight_cells(vector<pair<POS_T, POS_T>> cells)
     {
@@ -151,9 +163,9 @@ public:
     void clear_highlight()
     {
         // Снятие выделения со всех клеток
-        for (POS_T i = 0; i < 8; ++i)
+        for (POS_T i = 0; i < Rules::Size; ++i)
         {
-            is_highlighted_[i].assign(8, 0);
+            is_highlighted_[i].assign(Rules::Size, 0);
         }
         rerender();
     }
@@ -201,6 +213,23 @@ public:
         rerender();
     }
 
+    // Показ позиции без изменения истории (просмотр разбора партии); res - картинка итога, -1 - без неё
+    void show_position(const vector<vector<POS_T>> &position, const int res = -1)
+    {
+        mtx = position;
+        game_results = res;
+        for (POS_T i = 0; i < Rules::Size; ++i)
+            is_highlighted_[i].assign(Rules::Size, 0);
+        active_x = -1;
+        active_y = -1;
+        rerender();
+    }
+
+    void set_title(const string &title)
+    {
+        SDL_SetWindowTitle(win, title.c_str());
+    }
+
     // Сброс размеров окна при изменении размера
     void reset_window_size()
     {
@@ -238,31 +267,21 @@ private:
     }
     void make_start_mtx()
     {
-        // Расположение фигур
-        for (POS_T i = 0; i < 8; ++i)
-        {
-            for (POS_T j = 0; j < 8; ++j)
-            {
-                mtx[i][j] = 0;
-                if (i < 3 && (i + j) % 2 == 1)
-                    mtx[i][j] = 2;
-                if (i > 4 && (i + j) % 2 == 1)
-                    mtx[i][j] = 1;
-            }
-        }
+        mtx = start_mtx();
         add_history();
     }
 
     // Перерисовка текстур
     void rerender()
     {
+        TRACE_ZONE("rerender");
         SDL_RenderClear(ren);
         SDL_RenderCopy(ren, board, NULL, NULL);
 
         // Отрисовка фигур
-        for (POS_T i = 0; i < 8; ++i)
+        for (POS_T i = 0; i < Rules::Size; ++i)
         {
-            for (POS_T j = 0; j < 8; ++j)
+            for (POS_T j = 0; j < Rules::Size; ++j)
             {
                 if (!mtx[i][j])
                     continue;
@@ -288,9 +307,9 @@ private:
         SDL_SetRenderDrawColor(ren, 0, 255, 0, 0);
         const double scale = 2.5;
         SDL_RenderSetScale(ren, scale, scale);
-        for (POS_T i = 0; i < 8; ++i)
+        for (POS_T i = 0; i < Rules::Size; ++i)
         {
-            for (POS_T j = 0; j < 8; ++j)
+            for (POS_T j = 0; j < Rules::Size; ++j)
             {
                 if (!is_highlighted_[i][j])
                     continue;
@@ -335,7 +354,10 @@ private:
             SDL_DestroyTexture(result_texture);
         }
 
-        SDL_RenderPresent(ren);
+        {
+            TRACE_ZONE("SDL_RenderPresent");
+            SDL_RenderPresent(ren);
+        }
         SDL_Delay(10);
         SDL_Event windowEvent;
         SDL_PollEvent(&windowEvent);
@@ -375,7 +397,7 @@ private:
     const string replay_path = textures_path + "replay.png";
     int active_x = -1, active_y = -1;
     int game_results = -1;
-    vector<vector<bool>> is_highlighted_ = vector<vector<bool>>(8, vector<bool>(8, 0));
-    vector<vector<POS_T>> mtx = vector<vector<POS_T>>(8, vector<POS_T>(8, 0));
+    vector<vector<bool>> is_highlighted_ = vector<vector<bool>>(Rules::Size, vector<bool>(Rules::Size, 0));
+    vector<vector<POS_T>> mtx = vector<vector<POS_T>>(Rules::Size, vector<POS_T>(Rules::Size, 0));
     vector<int> history_beat_series;
 };
@@ -13,11 +13,17 @@ public:
         reload();
     }
 
+    // Настройки из другого файла (библиотека движка: файл указывает вызывающая программа)
+    explicit Config(const string &settings_path) : path(settings_path)
+    {
+        reload();
+    }
+
     // Загрузка настроек из json
     void reload()
     {
-        std::ifstream fin(project_path + "settings.json");
-        fin >> config;
+        std::ifstream fin(path);
+        config = json::parse(fin, nullptr, true, true); // settings.json содержит комментарии
         fin.close();
     }
     // Возвращает значение настройки из JSON по указанным ключам
@@ -26,6 +32,13 @@ public:
         return config[setting_dir][setting_name];
     }
 
+    // Замена настройки в памяти, файл не меняется (у движков матча свои настройки бота)
+    void set(const string &setting_dir, const string &setting_name, const json &value)
+    {
+        config[setting_dir][setting_name] = value;
+    }
+
 private:
     json config;
+    string path = project_path + "settings.json";
 };
\ No newline at end of file
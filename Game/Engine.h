@@ -0,0 +1,226 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../Models/Analysis.h"
+#include "../Models/Move.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "Time_manager.h"
+
+// Поток движка: выполняет поиск ходов бота вне потока GUI
+class Engine
+{
+public:
+    Engine(Config *config) : config(config), logic(nullptr, config)
+    {
+        logic.set_limits(&limits);
+        worker = thread(&Engine::loop, this);
+    }
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    ~Engine()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            is_exit = true;
+        }
+        stop();
+        cv.notify_one();
+        worker.join();
+    }
+
+    // Запускает поиск лучших ходов на копии доски, результат приходит через future.
+    // Предыдущий поиск к этому моменту должен быть завершён (его future получен).
+    future<vector<move_pos>> search(vector<vector<POS_T>> mtx, const bool color, const int depth)
+    {
+        limits.reset();
+        return submit([this, mtx = move(mtx), color, depth]() {
+            logic.Max_depth = depth;
+            auto turns = logic.find_best_turns(mtx, color);
+            logic.learn_turn(mtx, color, turns, logic.last_score, depth);
+            return turns;
+        });
+    }
+
+    // Многовариантный анализ (подсказки, разбор партии) в потоке движка
+    future<vector<analysis_line>> analyse(vector<vector<POS_T>> mtx, const bool color, const int depth,
+                                          const size_t multi_pv)
+    {
+        limits.reset();
+        return submit([this, mtx = move(mtx), color, depth, multi_pv]() {
+            logic.Max_depth = depth;
+            return logic.analyse(mtx, color, multi_pv);
+        });
+    }
+
+    // Итеративное углубление до depth с ограничениями по времени и узлам (0 - без ограничения).
+    // report вызывается в потоке движка после каждой законченной глубины
+    future<vector<analysis_line>> iterate(vector<vector<POS_T>> mtx, const bool color, const int depth,
+                                          const size_t multi_pv, const double time_ms, const size_t max_nodes,
+                                          function<void(int, const vector<analysis_line> &, size_t)> report)
+    {
+        limits.reset();
+        set_time(time_ms);
+        limits.max_nodes = max_nodes;
+        return submit([this, mtx = move(mtx), color, depth, multi_pv, report = move(report)]() {
+            return logic.iterate(mtx, color, depth, multi_pv, [this, &report](int d, const vector<analysis_line> &lines) {
+                if (report)
+                    report(d, lines, logic.get_nodes());
+            });
+        });
+    }
+
+    // Поиск хода по часам ходящей стороны: глубина растёт, пока Time_manager не решит остановиться.
+    // Ход есть всегда, даже если не досчитана ни одна глубина; report - как у iterate
+    future<vector<analysis_line>> play(vector<vector<POS_T>> mtx, const bool color, const double remaining_ms,
+                                       const double increment_ms, const int moves_to_go, const double overhead_ms,
+                                       function<void(int, const vector<analysis_line> &, size_t)> report = nullptr)
+    {
+        limits.reset();
+        return submit([=, mtx = move(mtx), report = move(report)]() {
+            const auto start = chrono::steady_clock::now();
+            auto elapsed_ms = [start]() {
+                return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            };
+            auto legal = Notation::legal_turns(logic, mtx, color);
+            Time_manager time;
+            time.start(remaining_ms, increment_ms, moves_to_go, overhead_ms, legal.size(), last_scores[color]);
+            limits.set_time(max(time.hard_ms() - elapsed_ms(), 1.0));
+            int done_depth = -1;
+            auto lines = logic.iterate(mtx, color, Max_iterate_depth, 1, [&](int d, const vector<analysis_line> &found) {
+                done_depth = d;
+                if (report)
+                    report(d, found, logic.get_nodes());
+                if (found.empty())
+                    return;
+                const auto &best = found[0];
+                if (!time.next_depth(elapsed_ms(), best.turns, best.score, opponent_beats(mtx, color, best.turns)))
+                    limits.stop = true; // следующую глубину не начинаем
+            });
+            if (lines.empty() && !legal.empty())
+            {
+                // Жёсткий предел наступил раньше первой глубины: любой допустимый ход лучше просрочки
+                analysis_line line;
+                line.turns = legal[0];
+                lines.push_back(line);
+            }
+            if (!lines.empty())
+                last_scores[color] = lines[0].score;
+            if (!lines.empty() && done_depth >= 0)
+                logic.learn_turn(mtx, color, lines[0].turns, lines[0].score, done_depth);
+            return lines;
+        });
+    }
+
+    // Ограничение времени идущего поиска от текущего момента (0 - снять ограничение)
+    void set_time(const double time_ms)
+    {
+        if (time_ms > 0)
+            limits.set_time(time_ms);
+        else
+            limits.deadline = 0;
+    }
+
+    // Ограничение узлов идущего поиска (0 - снять ограничение)
+    void set_max_nodes(const size_t max_nodes)
+    {
+        limits.max_nodes = max_nodes;
+    }
+
+    // Просит текущий поиск остановиться, он вернёт пустой вектор ходов
+    void stop()
+    {
+        limits.stop = true;
+    }
+
+    // Новая партия: хеш-таблица и история отсечений очищаются, конфигурация остаётся.
+    // Глубокие результаты прошлой партии (итог неизвестен) уходят в файл обучения
+    future<void> new_game()
+    {
+        return submit([this]() {
+            logic.learn_game(-1, false);
+            logic.clear_tables();
+            last_scores[0] = last_scores[1] = 0;
+        });
+    }
+
+    // Конец партии: обучение логики движка на её поисках (Logic::learn_game)
+    future<void> learn_game(const int result, const bool no_moves_left)
+    {
+        return submit([this, result, no_moves_left]() { logic.learn_game(result, no_moves_left); });
+    }
+
+    // Пересоздание логики после перезагрузки конфигурации (новая игра)
+    future<void> reset()
+    {
+        return submit([this]() {
+            logic = Logic(nullptr, config);
+            logic.set_limits(&limits);
+            last_scores[0] = last_scores[1] = 0;
+        });
+    }
+
+    // Выполняет задачу в потоке движка
+    template <class F> auto submit(F f) -> future<decltype(f())>
+    {
+        auto task = make_shared<packaged_task<decltype(f())()>>(move(f));
+        auto res = task->get_future();
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.emplace_back([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return res;
+    }
+
+private:
+    // После хода turns соперник обязан бить
+    bool opponent_beats(const vector<vector<POS_T>> &mtx, const bool color, const vector<move_pos> &turns)
+    {
+        auto next = mtx;
+        for (auto &turn : turns)
+            next = logic.make_turn(next, turn);
+        logic.find_turns(!color, next);
+        return logic.have_beats;
+    }
+
+    void loop()
+    {
+        TRACE_THREAD("engine");
+        while (true)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [this]() { return is_exit || !tasks.empty(); });
+                if (is_exit)
+                    return;
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+private:
+    Config *config; // указатель на Config
+    Logic logic; // логика, принадлежащая потоку движка
+    search_limits limits; // флаг кооперативной остановки и лимиты поиска
+    double last_scores[2] = {0, 0}; // оценки прошлых ходов по часам каждой стороны
+    mutex mtx;
+    condition_variable cv;
+    deque<function<void()>> tasks; // очередь задач потока движка
+    bool is_exit = false;
+    thread worker;
+};
@@ -0,0 +1,293 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "../Models/Analysis.h"
+#include "Board.h"
+#include "Config.h"
+#include "Engine.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "Time_manager.h"
+#include "Trace.h"
+
+// Текстовый протокол движка в духе UCI (режим "Checkers engine"): команды по строкам из stdin,
+// ответы в stdout. Поток движка, хеш-таблица и история отсечений живут между командами
+class Engine_protocol
+{
+public:
+    // output - приёмник строк ответа (вызывается и из потока движка), nullptr - stdout
+    Engine_protocol(Config *config, function<void(const string &)> output = nullptr)
+            : config(config), engine(config), logic(nullptr, config), output(move(output))
+    {
+        mtx = Board::start_mtx();
+    }
+
+    ~Engine_protocol()
+    {
+        finish_search();
+    }
+
+    int run(istream &in = cin)
+    {
+        string line;
+        while (getline(in, line) && command(line))
+        {
+        }
+        finish_search();
+        return 0;
+    }
+
+    // Выполнение одной строки команды, false - команда quit
+    bool command(string line)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        istringstream cmd(line);
+        string name;
+        if (!(cmd >> name))
+            return true;
+        if (name == "quit")
+            return false;
+        if (name == "isready")
+            send("readyok");
+        else if (name == "newgame")
+            new_game();
+        else if (name == "position")
+            position(cmd);
+        else if (name == "go")
+            go(cmd);
+        else if (name == "stop")
+            release(true);
+        else if (name == "ponderhit")
+            ponderhit();
+        else if (name == "board")
+            send("board " + Notation::board_string(mtx) + (color ? " b" : " w") + " fen " + Notation::fen(mtx, color));
+        else
+            send("info string unknown command " + name);
+        return true;
+    }
+
+    // Оценка для вывода: отношение материала с точки зрения ходящего, выигрыш и проигрыш словами
+    static string score_name(const double score)
+    {
+        if (score >= INF)
+            return "win";
+        if (score <= 0)
+            return "loss";
+        ostringstream out;
+        out << score;
+        return out.str();
+    }
+
+private:
+    // Ограничения команды go
+    struct go_limits
+    {
+        int depth = Max_iterate_depth;
+        double movetime = 0; // мс, 0 - без ограничения
+        size_t nodes = 0;    // 0 - без ограничения
+        size_t multi_pv = 1;
+        bool infinite = false;
+        bool ponder = false;
+        bool trace = false;  // трасса поиска в файл секции "Trace" (сборка с -DCHECKERS_TRACE)
+        double time[2] = {0, 0};      // часы белых и черных, мс, 0 - без часов
+        double increment[2] = {0, 0}; // добавка за ход, мс
+        int moves_to_go = 0;          // ходов до конца периода, 0 - до конца партии
+    };
+
+    void new_game()
+    {
+        finish_search();
+        engine.new_game().wait();
+        mtx = Board::start_mtx();
+        color = 0;
+    }
+
+    // position startpos [moves ...] | position board <32 символа> <w|b> [moves ...] | position fen <FEN> [moves ...]
+    void position(istringstream &cmd)
+    {
+        finish_search();
+        const string error = Notation::parse_position(logic, cmd, mtx, color);
+        if (!error.empty())
+            send("info string " + error);
+    }
+
+    // go [depth N] [movetime MS] [nodes N] [multipv K] [infinite] [ponder] [trace]
+    //    [wtime MS] [btime MS] [winc MS] [binc MS] [movestogo N]
+    void go(istringstream &cmd)
+    {
+        finish_search();
+        go_limits lim;
+        string word;
+        while (cmd >> word)
+        {
+            if (word == "depth")
+                cmd >> lim.depth;
+            else if (word == "movetime")
+                cmd >> lim.movetime;
+            else if (word == "nodes")
+                cmd >> lim.nodes;
+            else if (word == "multipv")
+                cmd >> lim.multi_pv;
+            else if (word == "infinite")
+                lim.infinite = true;
+            else if (word == "ponder")
+                lim.ponder = true;
+            else if (word == "trace")
+                lim.trace = true;
+            else if (word == "wtime")
+                cmd >> lim.time[0];
+            else if (word == "btime")
+                cmd >> lim.time[1];
+            else if (word == "winc")
+                cmd >> lim.increment[0];
+            else if (word == "binc")
+                cmd >> lim.increment[1];
+            else if (word == "movestogo")
+                cmd >> lim.moves_to_go;
+        }
+        lim.depth = max(0, min(lim.depth, Max_iterate_depth));
+        lim.multi_pv = max<size_t>(lim.multi_pv, 1);
+        limits = lim;
+        {
+            lock_guard<mutex> lock(wait_mtx);
+            released = !(lim.ponder || lim.infinite);
+        }
+
+#ifdef CHECKERS_TRACE
+        if (lim.trace)
+            Trace::start(); // кроме поиска пишет и разбор команд, пока идёт поиск
+#else
+        if (lim.trace)
+            send("info string trace needs a build with -DCHECKERS_TRACE");
+#endif
+        const auto start = chrono::steady_clock::now();
+        auto report_info = [this, start](int depth, const vector<analysis_line> &lines, size_t nodes) {
+            report(depth, lines, nodes, start);
+        };
+        // Часы задают время хода, если нет явных лимитов; при обдумывании часы не используются.
+        // При обдумывании на ходу соперника лимиты включаются командой ponderhit
+        const bool by_clock = lim.time[color] > 0 && !lim.ponder && !lim.infinite && lim.movetime <= 0 &&
+                              lim.nodes == 0 && lim.depth == Max_iterate_depth && lim.multi_pv == 1;
+        auto future_lines = by_clock ? engine.play(mtx, color, lim.time[color], lim.increment[color], lim.moves_to_go,
+                                                   (*config)("Clock", "MoveOverheadMS"), report_info)
+                                     : engine.iterate(mtx, color, lim.depth, lim.multi_pv, lim.ponder ? 0 : lim.movetime,
+                                                      lim.ponder ? 0 : lim.nodes, report_info);
+        waiter = thread([this, future_lines = move(future_lines)]() mutable {
+            auto lines = future_lines.get();
+#ifdef CHECKERS_TRACE
+            if (limits.trace) // limits не меняются, пока жив waiter
+            {
+                const string file = project_path + string((*config)("Trace", "File"));
+                if (Trace::write_logged(file, project_path + "log.txt"))
+                    send("info string trace written to " + file);
+            }
+#endif
+            // В режимах ponder и infinite ответ выдаётся только после ponderhit или stop
+            unique_lock<mutex> lock(wait_mtx);
+            wait_cv.wait(lock, [this]() { return released; });
+            lock.unlock();
+            if (lines.empty())
+            {
+                send("bestmove none");
+                return;
+            }
+            string res = "bestmove " + Notation::turn_name(lines[0].turns);
+            if (!lines[0].pv.empty())
+                res += " ponder " + Notation::turn_name(lines[0].pv[0]);
+            send(res);
+        });
+    }
+
+    // Соперник сделал ожидаемый ход: обдумывание становится обычным поиском с лимитами go
+    void ponderhit()
+    {
+        if (!waiter.joinable() || !limits.ponder)
+            return;
+        limits.ponder = false;
+        if (limits.movetime > 0)
+        {
+            engine.set_time(limits.movetime);
+        }
+        else if (limits.time[color] > 0 && !limits.infinite && limits.nodes == 0 &&
+                 limits.depth == Max_iterate_depth && limits.multi_pv == 1)
+        {
+            // Ход по часам: обдумывание было бесплатным, теперь поиск идёт до нормы хода
+            // (не дольше жёсткого предела), как если бы он только начался
+            Time_manager time;
+            time.start(limits.time[color], limits.increment[color], limits.moves_to_go,
+                       (*config)("Clock", "MoveOverheadMS"), Notation::legal_turns(logic, mtx, color).size(), 0);
+            engine.set_time(max(min(time.optimum_ms(), time.hard_ms()), 1.0));
+        }
+        engine.set_max_nodes(limits.nodes);
+        if (!limits.infinite)
+            release(false);
+    }
+
+    // Разрешает выдать bestmove, при stop поиск ещё и останавливается
+    void release(const bool stop)
+    {
+        if (stop)
+            engine.stop();
+        {
+            lock_guard<mutex> lock(wait_mtx);
+            released = true;
+        }
+        wait_cv.notify_all();
+    }
+
+    // Остановка текущего поиска с выдачей bestmove (новая команда прерывает старую)
+    void finish_search()
+    {
+        if (!waiter.joinable())
+            return;
+        release(true);
+        waiter.join();
+    }
+
+    // info по каждому варианту законченной глубины, вызывается в потоке движка
+    void report(const int depth, const vector<analysis_line> &lines, const size_t nodes,
+                const chrono::steady_clock::time_point start)
+    {
+        const double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (size_t k = 0; k < lines.size(); ++k)
+        {
+            ostringstream out;
+            out << "info depth " << depth << " multipv " << k + 1 << " score " << score_name(lines[k].score)
+                << " nodes " << nodes << " nps " << size_t(nodes / max(sec, 1e-3)) << " time " << int(sec * 1000)
+                << " pv " << Notation::turn_name(lines[k].turns);
+            for (auto &turn : lines[k].pv)
+                out << " " << Notation::turn_name(turn);
+            send(out.str());
+        }
+    }
+
+    void send(const string &s)
+    {
+        lock_guard<mutex> lock(out_mtx);
+        if (output)
+            output(s);
+        else
+            cout << s << endl;
+    }
+
+private:
+    Config *config; // указатель на Config
+    Engine engine; // поток движка, живёт всё время работы протокола
+    Logic logic; // разбор ходов в потоке команд
+    vector<vector<POS_T>> mtx; // текущая позиция
+    bool color = 0; // сторона хода
+    go_limits limits; // лимиты последней команды go
+    thread waiter; // ждёт результат поиска и печатает bestmove
+    mutex wait_mtx;
+    condition_variable wait_cv;
+    bool released = true; // можно выдать bestmove
+    function<void(const string &)> output; // приёмник ответов, пусто - stdout
+    mutex out_mtx; // строки из потока команд и потока движка не перемешиваются
+};
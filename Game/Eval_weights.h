@@ -0,0 +1,53 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Веса оценки по количеству фигур (calc_score): вес дамки в шашках и надбавка шашке за каждую
+// пройденную строку. Файл весов - JSON, который пишет "Checkers tune" для одного BotScoringType
+struct eval_weights
+{
+    std::string mode; // BotScoringType, для которого подобраны веса
+    double king = 4;
+    double advance = 0;
+
+    // Прежние веса типа оценки: дамка - 4 шашки, с продвижением - 5 шашек и 0.05 за строку
+    static eval_weights defaults(const std::string &mode)
+    {
+        eval_weights res;
+        res.mode = mode;
+        if (mode == "NumberAndPotential")
+        {
+            res.king = 5;
+            res.advance = 0.05;
+        }
+        return res;
+    }
+
+    // false - файла нет или в нём нет весов
+    bool load(const std::string &path)
+    {
+        std::ifstream fin(path);
+        if (!fin)
+            return false;
+        const nlohmann::json j = nlohmann::json::parse(fin, nullptr, false);
+        if (j.is_discarded() || !j.contains("Mode") || !j.contains("King") || !j.contains("Advance"))
+            return false;
+        mode = j["Mode"].get<std::string>();
+        king = j["King"].get<double>();
+        advance = j["Advance"].get<double>();
+        return king > 0 && advance >= 0;
+    }
+
+    // Запись весов; info - сведения о подборе (число позиций, ошибка), движок их не читает
+    bool save(const std::string &path, const nlohmann::json &info) const
+    {
+        nlohmann::json j = info;
+        j["Mode"] = mode;
+        j["King"] = king;
+        j["Advance"] = advance;
+        std::ofstream fout(path);
+        fout << j.dump(4) << "\n";
+        return bool(fout);
+    }
+};
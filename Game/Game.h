@@ -1,17 +1,31 @@
 #pragma once
 #include <chrono>
+#include <ctime>
+#include <future>
+#include <iomanip>
+#include <sstream>
 #include <thread>
 
+#include "../Models/Pdn_game.h"
 #include "../Models/Project_path.h"
 #include "Board.h"
 #include "Config.h"
+#include "Engine.h"
+#include "Game_review.h"
 #include "Hand.h"
 #include "Logic.h"
+#include "Notation.h"
+#include "Pdn_file.h"
+#include "Time_manager.h"
+#include "Trace.h"
+
+const int Poll_period_ms = 5; // период опроса событий окна, пока бот думает
 
 class Game
 {
 public:
-    Game() : board(config("WindowSize", "Width"), config("WindowSize", "Hight")), hand(&board), logic(&board, &config)
+    Game() : board(config("WindowSize", "Width"), config("WindowSize", "Hight")), hand(&board), logic(&board, &config),
+             engine(&config), clock(&config)
     {
         ofstream fout(project_path + "log.txt", ios_base::trunc);
         fout.close();
@@ -25,6 +39,8 @@ public:
         {
             logic = Logic(&board, &config);  // Пересоздание логики для новой игры.
             config.reload();  // Перезагрузка конфигурации.
+            engine.reset().wait(); // Новая логика и в потоке движка.
+            clock = Game_clock(&config); // Часы по новой конфигурации.
             board.redraw();   // Перерисовка игровой доски.
         }
         else
@@ -32,12 +48,21 @@ public:
             board.start_draw(); // Инициализация и отрисовка стартовой доски
         }
         is_replay = false;
+        clock.reset();
+        is_flag_fall = false;
+#ifdef CHECKERS_TRACE
+        TRACE_THREAD("gui");
+        ++game_index;
+#endif
 
         int turn_num = -1;
         bool is_quit = false;
         const int Max_turns = config("Game", "MaxNumTurns");
         while (++turn_num < Max_turns)
         {
+#ifdef CHECKERS_TRACE
+            trace_ply(turn_num);
+#endif
             beat_series = 0; // Сброс серии ударов
             logic.find_turns(turn_num % 2); // Поиск возможных ходов для текущего игрока
             if (logic.turns.empty())
@@ -46,7 +71,10 @@ public:
             if (!config("Bot", string("Is") + string((turn_num % 2) ? "Black" : "White") + string("Bot")))
             {
                 // Ход игрока
+                auto turn_start = chrono::steady_clock::now();
                 auto resp = player_turn(turn_num % 2);
+                if (resp == Response::OK && !spend_clock(turn_num % 2, turn_start))
+                    break; // время игрока вышло - он проиграл
                 if (resp == Response::QUIT)
                 {
                     is_quit = true; // Завершение игры
@@ -75,12 +103,45 @@ public:
                 }
             }
             else
-                bot_turn(turn_num % 2); // Ход бота
+            {
+                // Ход бота, во время поиска окно продолжает обрабатывать события
+                auto resp = bot_turn(turn_num % 2);
+                if (is_flag_fall)
+                    break;
+                if (resp == Response::QUIT)
+                {
+                    is_quit = true;
+                    break;
+                }
+                else if (resp == Response::REPLAY)
+                {
+                    is_replay = true;
+                    break;
+                }
+                else if (resp == Response::BACK)
+                {
+                    // Бот ещё не ходил: откатываем последний ход соперника
+                    board.rollback();
+                    turn_num -= 2;
+                }
+            }
         }
+#ifdef CHECKERS_TRACE
+        if (Trace::is_active())
+            save_trace();
+#endif
         auto end = chrono::steady_clock::now(); // Время окончания игры
         ofstream fout(project_path + "log.txt", ios_base::app);
         fout << "Game time: " << (int)chrono::duration<double, milli>(end - start).count() << " millisec\n";
         fout.close();
+        // Обучение движка на партии; у ходящего нет ходов - партия проиграна на доске, а не по времени
+        const int result_code = (is_replay || is_quit) ? -1 : (turn_num == Max_turns ? 0 : (turn_num % 2 ? 1 : 2));
+        engine.learn_game(result_code, result_code > 0 && !is_flag_fall).wait();
+        // Прерванная партия сохраняется без результата
+        if (is_replay || is_quit)
+            save_pdn("*");
+        else
+            save_pdn(turn_num == Max_turns ? "1-1" : (turn_num % 2 ? "2-0" : "0-2"));
 
         if (is_replay)
             return play(); // Повторный запуск игры
@@ -96,7 +157,7 @@ public:
             res = 1; // Победа одного из игроков
         }
         board.show_final(res); // Показ результата игры
-        auto resp = hand.wait();
+        auto resp = wait_final(res);
         if (resp == Response::REPLAY)
         {
             is_replay = true;
@@ -106,14 +167,244 @@ public:
     }
 
 private:
-    void bot_turn(const bool color)
+    // Ожидание после партии. Разбор партии (секция "Review") идёт сразу при Enabled, иначе по первому
+    // нажатию стрелки или кнопки возврата. Затем ходы просматриваются стрелками и кнопкой возврата:
+    // позиция перед ходом, поле сыгранного хода (красное) и у отмеченных ходов поля лучшего хода
+    // (зелёные), запись хода и его потеря - в заголовке окна
+    Response wait_final(const int res)
     {
+        vector<review_move> review;
+        bool is_reviewed = false;
+        if (config("Review", "Enabled"))
+        {
+            auto resp = run_review(review);
+            if (resp != Response::OK)
+                return resp;
+            is_reviewed = true;
+        }
+        else
+        {
+            board.set_title("Checkers - arrows: review the game");
+        }
+        size_t index = review.size(); // показана итоговая позиция
+        while (true)
+        {
+            auto resp = hand.wait();
+            if (resp != Response::BACK && resp != Response::NEXT)
+                return resp;
+            if (!is_reviewed)
+            {
+                // Разбор по запросу игрока
+                resp = run_review(review);
+                if (resp != Response::OK)
+                    return resp;
+                is_reviewed = true;
+                index = review.size();
+                resp = Response::BACK; // первое нажатие сразу показывает последний ход
+            }
+            if (resp == Response::BACK && index > 0)
+                --index;
+            else if (resp == Response::NEXT && index < review.size())
+                ++index;
+            else
+                continue;
+            show_review(review, index, res);
+        }
+    }
+
+    // Разбор партии в пуле потоков, пока окно обрабатывает события. REPLAY и QUIT прерывают разбор
+    Response run_review(vector<review_move> &review)
+    {
+        board.set_title("Checkers - reviewing the game...");
+        Game_review reviewer(&config);
+        const auto start = board.history_mtx.front();
+        const auto turns = history_turns();
+        auto future_review = async(launch::async, [&]() { return reviewer.review(start, turns); });
+        while (future_review.wait_for(chrono::milliseconds(Poll_period_ms)) != future_status::ready)
+        {
+            auto resp = hand.poll();
+            if (resp == Response::REPLAY || resp == Response::QUIT)
+            {
+                reviewer.stop();
+                future_review.wait();
+                return resp;
+            }
+        }
+        review = future_review.get();
+        size_t blunders = 0, missed = 0;
+        for (auto &m : review)
+        {
+            blunders += m.is_blunder;
+            missed += m.is_missed_capture;
+        }
+        review_title = "Checkers - " + to_string(blunders) + " blunders, " + to_string(missed) +
+                       " missed captures (arrows - step through the moves)";
+        board.set_title(review_title);
+        return Response::OK;
+    }
+
+    // Ход index разбора на доске; index == review.size() - итоговая позиция с результатом res
+    void show_review(const vector<review_move> &review, const size_t index, const int res)
+    {
+        if (index == review.size())
+        {
+            board.show_position(board.history_mtx.back(), res);
+            board.set_title(review_title);
+            return;
+        }
+        const review_move &m = review[index];
+        board.show_position(m.mtx);
+        board.set_active(m.played[0].x, m.played[0].y);
+        string title = "Checkers - " + to_string(index / 2 + 1) + (m.color ? "... " : ". ") +
+                       Notation::turn_name(m.played);
+        if (!m.flags().empty())
+        {
+            board.highlight_cells({{m.best[0].x, m.best[0].y}, {m.best.back().x2, m.best.back().y2}});
+            ostringstream swing;
+            swing << fixed << setprecision(2) << m.swing;
+            title += " (" + m.flags() + "), best " + Notation::turn_name(m.best) + ", swing " + swing.str();
+        }
+        board.set_title(title);
+    }
+
+    // Дописывает партию в PdnFile из секции "Game" (пустая строка - не сохранять)
+    void save_pdn(const string &result)
+    {
+        const string file = config("Game", "PdnFile");
+        if (file.empty() || board.history_mtx.size() < 2)
+            return;
+        pdn_game game;
+        char date[16];
+        time_t now = time(0);
+        strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+        game.set_tag("Event", "Checkers");
+        game.set_tag("Date", date);
+        for (string side : {"White", "Black"})
+        {
+            game.set_tag(side, config("Bot", "Is" + side + "Bot")
+                                       ? "Bot level " + to_string(int(config("Bot", side + "BotLevel")))
+                                       : "Player");
+        }
+        if (clock.enabled())
+            game.set_tag("TimeControl", clock.time_control());
+        game.set_tag("Result", result);
+        game.set_tag("GameType", "25"); // русские шашки
+        for (auto &turn : history_turns())
+            game.moves.push_back(Notation::turn_name(turn));
+        game.result = result;
+        try
+        {
+            Pdn_writer(project_path + file).write(game);
+        }
+        catch (const exception &e)
+        {
+            ofstream fout(project_path + "log.txt", ios_base::app);
+            fout << "Error: " << e.what() << "\n";
+        }
+    }
+
+    // Полные ходы партии, восстановленные по истории досок: каждый снимок - один шаг,
+    // шаги одного цвета подряд - одна серия ударов
+    vector<vector<move_pos>> history_turns() const
+    {
+        vector<vector<move_pos>> res;
+        bool last_color = 1;
+        for (size_t k = 1; k < board.history_mtx.size(); ++k)
+        {
+            const auto &a = board.history_mtx[k - 1], &b = board.history_mtx[k];
+            POS_T x = -1, y = -1, x2 = -1, y2 = -1, xb = -1, yb = -1;
+            for (POS_T i = 0; i < 8; ++i)
+            {
+                for (POS_T j = 0; j < 8; ++j)
+                {
+                    if (!a[i][j] && b[i][j])
+                    {
+                        x2 = i;
+                        y2 = j;
+                    }
+                }
+            }
+            if (x2 == -1)
+                continue;
+            for (POS_T i = 0; i < 8; ++i)
+            {
+                for (POS_T j = 0; j < 8; ++j)
+                {
+                    if (!a[i][j] || b[i][j])
+                        continue;
+                    if (a[i][j] % 2 == b[x2][y2] % 2)
+                    {
+                        x = i;
+                        y = j;
+                    }
+                    else
+                    {
+                        xb = i;
+                        yb = j;
+                    }
+                }
+            }
+            const bool color = (b[x2][y2] % 2 == 0);
+            if (res.empty() || color != last_color)
+                res.emplace_back();
+            res.back().emplace_back(x, y, x2, y2, xb, yb);
+            last_color = color;
+        }
+        return res;
+    }
+
+    Response bot_turn(const bool color)
+    {
+        TRACE_ZONE("bot_turn");
         auto start = chrono::steady_clock::now(); // Время начала хода бота
 
-        auto delay_ms = config("Bot", "BotDelayMS");
-        thread th(SDL_Delay, delay_ms);
-        auto turns = logic.find_best_turns(color); // Поиск ходов для бота
-        th.join();
+        int delay_ms = config("Bot", "BotDelayMS");
+        // Поиск ходов для бота в потоке движка: по часам или на глубину уровня бота
+        future<vector<move_pos>> future_turns;
+        future<vector<analysis_line>> future_lines;
+        if (clock.enabled())
+            future_lines = engine.play(board.get_board(), color, clock.remaining_ms(color), clock.get_increment_ms(),
+                                       clock.moves_to_go(color), clock.get_overhead_ms());
+        else
+            future_turns = engine.search(board.get_board(), color, logic.Max_depth);
+        // Пока бот думает (и не истекла минимальная задержка), обрабатываем события окна
+        auto thinking_end = start;
+        bool is_ready = false;
+        while (!is_ready || chrono::steady_clock::now() - start < chrono::milliseconds(delay_ms))
+        {
+            if (!is_ready)
+            {
+                auto status = clock.enabled() ? future_lines.wait_for(chrono::milliseconds(Poll_period_ms))
+                                              : future_turns.wait_for(chrono::milliseconds(Poll_period_ms));
+                is_ready = (status == future_status::ready);
+                thinking_end = chrono::steady_clock::now();
+            }
+            else
+            {
+                SDL_Delay(Poll_period_ms);
+            }
+            auto resp = hand.poll();
+            if (resp != Response::OK)
+            {
+                engine.stop(); // поиск остановится через несколько миллисекунд
+                clock.enabled() ? future_lines.wait() : future_turns.wait();
+                return resp;
+            }
+        }
+        vector<move_pos> turns;
+        if (clock.enabled())
+        {
+            auto lines = future_lines.get();
+            if (!lines.empty())
+                turns = lines[0].turns;
+            // Часы бота идут только пока он думает, задержка показа хода не считается
+            if (!spend_clock(color, start, thinking_end))
+                return Response::OK;
+        }
+        else
+        {
+            turns = future_turns.get();
+        }
         bool is_first = true;
 
         // Выполнение ходов
@@ -132,6 +423,43 @@ private:
         ofstream fout(project_path + "log.txt", ios_base::app);
         fout << "Bot turn time: " << (int)chrono::duration<double, milli>(end - start).count() << " millisec\n";
         fout.close(); // Запись времени хода бота в лог-файл
+        return Response::OK;
+    }
+
+#ifdef CHECKERS_TRACE
+    // Трасса партии номер Game из секции "Trace" (с начала запуска): полуходы [FromPly, ToPly),
+    // ToPly 0 - до конца партии. Один ход бота - ToPly = FromPly + 1
+    void trace_ply(const int turn_num)
+    {
+        if (game_index != int(config("Trace", "Game")))
+            return;
+        const int from = config("Trace", "FromPly");
+        const int to = config("Trace", "ToPly");
+        if (turn_num == from && !Trace::is_active())
+            Trace::start();
+        else if (to > 0 && turn_num >= to && Trace::is_active())
+            save_trace();
+    }
+
+    void save_trace()
+    {
+        const string file = config("Trace", "File");
+        Trace::write_logged(project_path + file, project_path + "log.txt");
+    }
+#endif
+
+    // Списывает со часов color время хода от start до end. false - флаг упал, партия проиграна
+    bool spend_clock(const bool color, const chrono::steady_clock::time_point start,
+                     const chrono::steady_clock::time_point end = chrono::steady_clock::now())
+    {
+        if (!clock.enabled())
+            return true;
+        const double used_ms = chrono::duration<double, milli>(end - start).count();
+        is_flag_fall = !clock.spend(color, used_ms);
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        fout << (color ? "Black" : "White") << " clock: " << int(clock.remaining_ms(color)) << " millisec left"
+             << (is_flag_fall ? ", lost on time" : "") << "\n";
+        return !is_flag_fall;
     }
 
     Response player_turn(const bool color)
@@ -253,6 +581,13 @@ private:
     Board board;
     Hand hand;
     Logic logic;
+    Engine engine;
+    Game_clock clock; // часы партии (секция "Clock")
+    bool is_flag_fall = false; // время ходящей стороны вышло
     int beat_series;
     bool is_replay = false;
+    string review_title; // заголовок окна с итогом разбора партии
+#ifdef CHECKERS_TRACE
+    int game_index = 0; // номер партии с начала запуска
+#endif
 };
@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "../Models/Analysis.h"
+#include "../Models/Move.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "ThreadPool.h"
+
+// Разбор одного хода партии: позиция до хода, сыгранный и лучший ходы с оценками с точки зрения
+// ходившей стороны (отношение материала, 1e9 - выигрыш, 0 - проигрыш)
+struct review_move
+{
+    vector<vector<POS_T>> mtx; // позиция перед ходом
+    bool color = 0;            // ходившая сторона
+    vector<move_pos> played;
+    vector<move_pos> best;     // пусто - поиск прерван
+    double played_score = 0;
+    double best_score = 0;
+    double swing = 0;          // потеря доли выигрыша из-за хода, от 0 до 1
+    bool is_blunder = false;
+    bool is_missed_capture = false; // лучший ход бьёт больше фигур, чем сыгранный
+
+    // Пометка хода для лога и заголовка окна, пустая строка - ход не отмечен
+    string flags() const
+    {
+        string res = is_blunder ? "blunder" : "";
+        if (is_missed_capture)
+            res += string(res.empty() ? "" : ", ") + "missed capture";
+        return res;
+    }
+};
+
+// Разбор сыгранной партии (секция "Review"): все позиции перед ходами считаются параллельно на пуле
+// потоков, у каждого потока своя логика. Лучший ход ищется на глубину Depth, сыгранный - поиском
+// позиции после него на глубину Depth - 1 за соперника. Потеря хода - разница долей выигрыша
+// q = r / (1 + r) лучшего и сыгранного ходов
+class Game_review
+{
+public:
+    Game_review(Config *config) : config(config)
+    {
+    }
+
+    // Разбор ходов turns из начальной позиции start (первыми ходят белые). Остановленный разбор
+    // возвращает пустой вектор
+    vector<review_move> review(const vector<vector<POS_T>> &start, const vector<vector<move_pos>> &turns)
+    {
+        auto begin = chrono::steady_clock::now();
+        const size_t threads = (*config)("Review", "Threads");
+        vector<review_move> res(turns.size());
+        {
+            Logic replay(nullptr, config);
+            auto mtx = start;
+            for (size_t k = 0; k < turns.size(); ++k)
+            {
+                res[k].mtx = mtx;
+                res[k].color = (k % 2 == 1);
+                res[k].played = turns[k];
+                for (auto &step : turns[k])
+                    mtx = replay.make_turn(mtx, step);
+            }
+        }
+        {
+            ThreadPool pool(threads);
+            for (auto &item : res)
+                pool.submit([this, &item]() { review_one(item); });
+            pool.wait();
+        }
+        if (limits.stop)
+            return {};
+        const double sec = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        write_log(res, sec);
+        return res;
+    }
+
+    // Остановка разбора из другого потока: идущие поиски прерываются, остальные позиции пропускаются
+    void stop()
+    {
+        limits.stop = true;
+    }
+
+private:
+    void review_one(review_move &item)
+    {
+        if (limits.stop)
+            return;
+        auto logic = take_logic();
+        const int depth = (*config)("Review", "Depth");
+        logic->Max_depth = depth;
+        auto lines = logic->analyse(item.mtx, item.color, 1);
+        if (!lines.empty())
+        {
+            item.best = lines[0].turns;
+            item.best_score = lines[0].score;
+            item.played_score = item.best_score;
+            if (item.played != item.best)
+            {
+                auto mtx = item.mtx;
+                for (auto &step : item.played)
+                    mtx = logic->make_turn(mtx, step);
+                logic->Max_depth = max(0, depth - 1);
+                auto reply = logic->analyse(mtx, !item.color, 1);
+                if (reply.empty())
+                {
+                    logic->find_turns(!item.color, mtx);
+                    if (!logic->turns.empty())
+                        item.best.clear(); // поиск прерван
+                    item.played_score = INF; // у соперника нет ходов
+                }
+                else
+                {
+                    item.played_score = invert(reply[0].score);
+                }
+            }
+            const double blunder_swing = (*config)("Review", "BlunderSwing");
+            const double capture_swing = (*config)("Review", "MissedCaptureSwing");
+            item.swing = max(0.0, win_share(item.best_score) - win_share(item.played_score));
+            item.is_blunder = !item.best.empty() && item.swing >= blunder_swing;
+            item.is_missed_capture =
+                    !item.best.empty() && captures(item.best) > captures(item.played) && item.swing >= capture_swing;
+        }
+        give_logic(move(logic));
+    }
+
+    // Лог разбора: каждый ход с оценками, отмеченные ходы - с лучшим ходом и потерей
+    void write_log(const vector<review_move> &res, const double sec) const
+    {
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        size_t blunders = 0, missed = 0;
+        for (size_t k = 0; k < res.size(); ++k)
+        {
+            const review_move &m = res[k];
+            fout << "Review " << k / 2 + 1 << (m.color ? "... " : ". ") << Notation::turn_name(m.played) << " score "
+                 << m.played_score;
+            if (m.best.empty())
+            {
+                fout << ", not analysed\n";
+                continue;
+            }
+            if (m.played != m.best)
+                fout << ", best " << Notation::turn_name(m.best) << " " << m.best_score << ", swing " << m.swing;
+            if (!m.flags().empty())
+                fout << " (" << m.flags() << ")";
+            fout << "\n";
+            blunders += m.is_blunder;
+            missed += m.is_missed_capture;
+        }
+        fout << "Review: " << res.size() << " moves, " << blunders << " blunders, " << missed
+             << " missed captures, depth " << int((*config)("Review", "Depth")) << ", " << int(sec * 1000)
+             << " millisec\n";
+    }
+
+    // Логика потока: хеш-таблица переходит от позиции к позиции
+    unique_ptr<Logic> take_logic()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (!logics.empty())
+            {
+                auto logic = move(logics.back());
+                logics.pop_back();
+                return logic;
+            }
+        }
+        auto logic = make_unique<Logic>(nullptr, config);
+        logic->set_hash_size_mb((*config)("Review", "HashSizeMB"));
+        logic->set_engine("AlphaBeta"); // глубина разбора - глубина перебора
+        logic->set_limits(&limits);
+        return logic;
+    }
+
+    void give_logic(unique_ptr<Logic> logic)
+    {
+        lock_guard<mutex> lock(mtx);
+        logics.push_back(move(logic));
+    }
+
+    // Оценка той же позиции с точки зрения соперника
+    static double invert(const double score)
+    {
+        if (score >= INF)
+            return 0;
+        if (score <= 0)
+            return INF;
+        return 1 / score;
+    }
+
+    // Доля выигрыша по отношению материала
+    static double win_share(const double score)
+    {
+        return score >= INF ? 1 : score / (1 + score);
+    }
+
+    static int captures(const vector<move_pos> &turn)
+    {
+        int res = 0;
+        for (auto &step : turn)
+            res += (step.xb != -1);
+        return res;
+    }
+
+private:
+    Config *config; // указатель на Config
+    search_limits limits; // общая остановка поисков разбора
+    mutex mtx;
+    vector<unique_ptr<Logic>> logics; // свободные логики потоков
+};
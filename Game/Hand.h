@@ -66,6 +66,41 @@ public:
         return {resp, xc, yc};
     }
 
+    // Обработка накопившихся событий без ожидания (пока думает бот).
+    // Возвращает QUIT, REPLAY или BACK, если игрок их запросил, иначе OK
+    Response poll() const
+    {
+        SDL_Event windowEvent;
+        Response resp = Response::OK;
+        while (resp == Response::OK && SDL_PollEvent(&windowEvent))
+        {
+            switch (windowEvent.type)
+            {
+                case SDL_QUIT:
+                    resp = Response::QUIT; // Закрытие окна
+                    break;
+                case SDL_MOUSEBUTTONDOWN: {
+                    int x = windowEvent.motion.x;
+                    int y = windowEvent.motion.y;
+                    int xc = int(y / (board->H / 10) - 1);
+                    int yc = int(x / (board->W / 10) - 1);
+                    if (xc == -1 && yc == -1 && board->history_mtx.size() > 1)
+                        resp = Response::BACK; // Возврат хода
+                    else if (xc == -1 && yc == 8)
+                        resp = Response::REPLAY; // Перезапуск игры
+                }
+                    break;
+                case SDL_WINDOWEVENT:
+                    if (windowEvent.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                        board->reset_window_size(); // Изменение размера окна -> обновление размеров доски
+                    break;
+            }
+        }
+        return resp;
+    }
+
+    // Ожидание после партии: REPLAY, QUIT, а также BACK (кнопка возврата или стрелка влево)
+    // и NEXT (стрелка вправо) для просмотра разбора партии
     Response wait() const
     {
         SDL_Event windowEvent;
@@ -89,8 +124,16 @@ public:
                         int yc = int(x / (board->W / 10) - 1);
                         if (xc == -1 && yc == 8)
                             resp = Response::REPLAY; // Перезапуск игры
+                        else if (xc == -1 && yc == -1)
+                            resp = Response::BACK; // Предыдущий ход разбора
                     }
                         break;
+                    case SDL_KEYDOWN:
+                        if (windowEvent.key.keysym.sym == SDLK_LEFT)
+                            resp = Response::BACK;
+                        else if (windowEvent.key.keysym.sym == SDLK_RIGHT)
+                            resp = Response::NEXT;
+                        break;
                 }
                 if (resp != Response::OK)
                     break;
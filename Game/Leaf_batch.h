@@ -0,0 +1,188 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "../Models/Move.h"
+
+// Маски строк доски по 32 тёмным полям (index = i * 4 + j / 2): номер строки = index >> 2,
+// поэтому сумма номеров строк фигур = pc(m & Row_bit0) + 2 pc(m & Row_bit1) + 4 pc(m & Row_bit2)
+const uint32_t Row_bit0_mask = 0xF0F0F0F0; // строки 1, 3, 5, 7
+const uint32_t Row_bit1_mask = 0xFF00FF00; // строки 2, 3, 6, 7
+const uint32_t Row_bit2_mask = 0xFFFF0000; // строки 4, 5, 6, 7
+
+inline int popcount32(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return int((((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#endif
+}
+
+// Сумма номеров строк фигур маски
+inline int row_sum32(const uint32_t x)
+{
+    return popcount32(x & Row_bit0_mask) + 2 * popcount32(x & Row_bit1_mask) + 4 * popcount32(x & Row_bit2_mask);
+}
+
+// Пачка листовых позиций в виде битовых масок (структура массивов) и векторный подсчёт
+// количества фигур и сумм номеров строк для оценки calc_score
+class Leaf_batch
+{
+public:
+    void clear()
+    {
+        wm.clear();
+        bm.clear();
+        wq.clear();
+        bq.clear();
+    }
+
+    size_t size() const
+    {
+        return wm.size();
+    }
+
+    // Упаковка доски в маски: белые шашки, черные шашки, белые дамки, черные дамки
+    static void pack(const std::vector<std::vector<POS_T>> &mtx, uint32_t masks[4])
+    {
+        masks[0] = masks[1] = masks[2] = masks[3] = 0;
+        for (POS_T i = 0; i < 8; ++i)
+        {
+            for (POS_T j = (i + 1) % 2; j < 8; j += 2)
+            {
+                if (mtx[i][j])
+                    masks[mtx[i][j] - 1] |= uint32_t(1) << (i * 4 + j / 2);
+            }
+        }
+    }
+
+    // Добавляет позицию после тихого хода turn из позиции masks (без взятия)
+    void push_quiet(const uint32_t masks[4], const POS_T type, const move_pos &turn)
+    {
+        uint32_t m[4] = {masks[0], masks[1], masks[2], masks[3]};
+        POS_T new_type = type;
+        if ((type == 1 && turn.x2 == 0) || (type == 2 && turn.x2 == 7))
+            new_type += 2;
+        m[type - 1] &= ~(uint32_t(1) << (turn.x * 4 + turn.y / 2));
+        m[new_type - 1] |= uint32_t(1) << (turn.x2 * 4 + turn.y2 / 2);
+        wm.push_back(m[0]);
+        bm.push_back(m[1]);
+        wq.push_back(m[2]);
+        bq.push_back(m[3]);
+    }
+
+    // Подсчёт по всей пачке: w, wq, b, bq - количества фигур, rw, rb - суммы номеров строк шашек
+    void count()
+    {
+        const size_t n = size();
+        const size_t padded = (n + 7) / 8 * 8;
+        for (auto *v : {&wm, &bm, &wq, &bq})
+            v->resize(padded, 0);
+        for (auto *v : {&w, &b, &wqc, &bqc, &rw, &rb})
+            v->resize(padded);
+        size_t k = 0;
+#if defined(__AVX2__)
+        for (; k < padded; k += 8)
+        {
+            __m256i m_wm = load(wm, k), m_bm = load(bm, k);
+            store(w, k, popcount8(m_wm));
+            store(b, k, popcount8(m_bm));
+            store(wqc, k, popcount8(load(wq, k)));
+            store(bqc, k, popcount8(load(bq, k)));
+            store(rw, k, row_sum8(m_wm));
+            store(rb, k, row_sum8(m_bm));
+        }
+#elif defined(__SSSE3__)
+        for (; k < padded; k += 4)
+        {
+            __m128i m_wm = load(wm, k), m_bm = load(bm, k);
+            store(w, k, popcount4(m_wm));
+            store(b, k, popcount4(m_bm));
+            store(wqc, k, popcount4(load(wq, k)));
+            store(bqc, k, popcount4(load(bq, k)));
+            store(rw, k, row_sum4(m_wm));
+            store(rb, k, row_sum4(m_bm));
+        }
+#endif
+        for (; k < padded; ++k)
+        {
+            w[k] = popcount32(wm[k]);
+            b[k] = popcount32(bm[k]);
+            wqc[k] = popcount32(wq[k]);
+            bqc[k] = popcount32(bq[k]);
+            rw[k] = row_sum32(wm[k]);
+            rb[k] = row_sum32(bm[k]);
+        }
+        for (auto *v : {&wm, &bm, &wq, &bq})
+            v->resize(n);
+    }
+
+public:
+    // Результаты count(), по индексу позиции в пачке
+    std::vector<int32_t> w, b, wqc, bqc, rw, rb;
+
+private:
+#if defined(__AVX2__)
+    static __m256i load(const std::vector<uint32_t> &v, const size_t k)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v.data() + k));
+    }
+    static void store(std::vector<int32_t> &v, const size_t k, const __m256i x)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(v.data() + k), x);
+    }
+    // popcount 8 32-битных масок: таблица по полубайтам и сумма байтов в каждой маске
+    static __m256i popcount8(const __m256i x)
+    {
+        const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+                                             2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0F);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+                                      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+        return _mm256_madd_epi16(_mm256_maddubs_epi16(cnt, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+    }
+    static __m256i row_sum8(const __m256i x)
+    {
+        __m256i r0 = popcount8(_mm256_and_si256(x, _mm256_set1_epi32(int(Row_bit0_mask))));
+        __m256i r1 = popcount8(_mm256_and_si256(x, _mm256_set1_epi32(int(Row_bit1_mask))));
+        __m256i r2 = popcount8(_mm256_and_si256(x, _mm256_set1_epi32(int(Row_bit2_mask))));
+        return _mm256_add_epi32(r0, _mm256_add_epi32(_mm256_slli_epi32(r1, 1), _mm256_slli_epi32(r2, 2)));
+    }
+#elif defined(__SSSE3__)
+    static __m128i load(const std::vector<uint32_t> &v, const size_t k)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(v.data() + k));
+    }
+    static void store(std::vector<int32_t> &v, const size_t k, const __m128i x)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v.data() + k), x);
+    }
+    static __m128i popcount4(const __m128i x)
+    {
+        const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m128i low = _mm_set1_epi8(0x0F);
+        __m128i cnt = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(x, low)),
+                                   _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), low)));
+        return _mm_madd_epi16(_mm_maddubs_epi16(cnt, _mm_set1_epi8(1)), _mm_set1_epi16(1));
+    }
+    static __m128i row_sum4(const __m128i x)
+    {
+        __m128i r0 = popcount4(_mm_and_si128(x, _mm_set1_epi32(int(Row_bit0_mask))));
+        __m128i r1 = popcount4(_mm_and_si128(x, _mm_set1_epi32(int(Row_bit1_mask))));
+        __m128i r2 = popcount4(_mm_and_si128(x, _mm_set1_epi32(int(Row_bit2_mask))));
+        return _mm_add_epi32(r0, _mm_add_epi32(_mm_slli_epi32(r1, 1), _mm_slli_epi32(r2, 2)));
+    }
+#endif
+
+private:
+    std::vector<uint32_t> wm, bm, wq, bq; // маски позиций пачки
+};
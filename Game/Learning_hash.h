@@ -0,0 +1,236 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Transposition_table.h"
+
+// Заголовок файла обучения: магия, версия, размер записи, подпись оценки и число записей
+const char Learning_file_magic[4] = {'C', 'K', 'L', 'H'};
+const uint16_t Learning_file_version = 2; // 2 - ключи узла и его отражения совпадают
+
+struct learning_header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t signature; // оценки разных функций оценки несравнимы, файл привязан к одной
+    uint32_t reserved;
+    uint64_t count;     // число записей, степень двойки
+};
+
+// Запись файла: value - биты оценки, data - глубина, граница и ход, check = key ^ value ^ data.
+// Запись, которую другой процесс переписал наполовину, не сойдётся ни с каким ключом,
+// поэтому чтение идёт без замков
+struct learn_entry
+{
+    uint64_t check;
+    uint64_t value;
+    uint64_t data;
+};
+
+// Постоянная хеш-таблица в файле, отображённом в память (секция "Learning"): глубокие результаты
+// поиска и уроки проигранных партий. Поиск смотрит в неё, как во второй уровень хеш-таблицы,
+// после промаха в своей; в конце партии новые записи вливаются в файл под файловым замком.
+// Читать файл одновременно могут несколько процессов движка
+class Learning_hash
+{
+public:
+    Learning_hash() = default;
+    Learning_hash(const Learning_hash &) = delete;
+    Learning_hash &operator=(const Learning_hash &) = delete;
+
+    ~Learning_hash()
+    {
+#ifndef _WIN32
+        if (entries)
+            munmap(map_base, map_size);
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    // Общий файл всех логик процесса (как веса сети), nullptr - файл не открылся
+    static std::shared_ptr<Learning_hash> open_shared(const std::string &path, const size_t size_mb,
+                                                      const uint32_t signature)
+    {
+        static std::mutex mtx;
+        static std::map<std::string, std::shared_ptr<Learning_hash>> cache;
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(path);
+        if (it != cache.end())
+            return (it->second && it->second->signature == signature) ? it->second : nullptr;
+        auto hash = std::make_shared<Learning_hash>();
+        std::shared_ptr<Learning_hash> res;
+        if (hash->open(path, size_mb, signature))
+            res = hash;
+        cache[path] = res;
+        return res;
+    }
+
+    // Подпись функции оценки для заголовка (FNV-1a, одинакова на всех платформах)
+    static uint32_t make_signature(const std::string &s)
+    {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : s)
+            h = (h ^ c) * 16777619u;
+        return h;
+    }
+
+    // Открывает или создаёт файл на size_mb мегабайт. Существующий файл сохраняет свой размер;
+    // false - файл не открылся или в нём оценки другой функции оценки
+    bool open(const std::string &path, const size_t size_mb, const uint32_t sign)
+    {
+#ifdef _WIN32
+        return false;
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return false;
+        flock(fd, LOCK_EX); // создание файла - под замком, чтобы два процесса не разметили его дважды
+        struct stat st;
+        learning_header header;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && st.st_size == 0)
+        {
+            uint64_t count = 1;
+            while (count * 2 * sizeof(learn_entry) <= size_mb * 1024 * 1024)
+                count *= 2;
+            memcpy(header.magic, Learning_file_magic, 4);
+            header.version = Learning_file_version;
+            header.entry_size = sizeof(learn_entry);
+            header.signature = sign;
+            header.reserved = 0;
+            header.count = count;
+            ok = pwrite(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                 ftruncate(fd, off_t(sizeof(header) + count * sizeof(learn_entry))) == 0;
+        }
+        else if (ok)
+        {
+            ok = pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                 memcmp(header.magic, Learning_file_magic, 4) == 0 && header.version == Learning_file_version &&
+                 header.entry_size == sizeof(learn_entry) && header.signature == sign && header.count > 0 &&
+                 (header.count & (header.count - 1)) == 0 &&
+                 uint64_t(st.st_size) >= sizeof(header) + header.count * sizeof(learn_entry);
+        }
+        flock(fd, LOCK_UN);
+        if (!ok)
+            return false;
+        map_size = sizeof(header) + header.count * sizeof(learn_entry);
+        map_base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map_base == MAP_FAILED)
+        {
+            map_base = nullptr;
+            return false;
+        }
+        entries = reinterpret_cast<learn_entry *>(static_cast<char *>(map_base) + sizeof(header));
+        mask = header.count - 1;
+        signature = sign;
+        return true;
+#endif
+    }
+
+    // Запись узла key, false - записи нет (или её как раз переписывает другой процесс)
+    bool probe(const uint64_t key, tt_entry &res) const
+    {
+        const volatile learn_entry &e = entries[key & mask];
+        const uint64_t data = e.data;
+        const uint64_t value = e.value;
+        const uint64_t check = e.check;
+        if (data == 0 || (check ^ value ^ data) != key)
+            return false;
+        unpack(key, value, data, res);
+        return true;
+    }
+
+    // Вливает записи в файл. Запись заменяет прежнюю в своей ячейке, если она не мельче
+    // (точная оценка той же позиции и глубины не заменяется границей);
+    // уроки проигрышей (is_lesson) вытесняются только другими уроками
+    void merge(const std::vector<tt_entry> &new_entries, const bool is_lesson)
+    {
+#ifndef _WIN32
+        std::lock_guard<std::mutex> lock(merge_mtx); // потоки процесса делят один дескриптор
+        flock(fd, LOCK_EX);
+        for (auto &n : new_entries)
+        {
+            volatile learn_entry &e = entries[n.key & mask];
+            const uint64_t old_data = e.data;
+            if (old_data != 0)
+            {
+                const bool old_lesson = (old_data >> Lesson_shift) & 1;
+                const int old_depth = int(old_data & 0x7F);
+                if ((old_lesson && !is_lesson) || (old_lesson == is_lesson && old_depth > n.depth))
+                    continue;
+                // Та же позиция на той же глубине: граница не заменяет точную оценку
+                const bool old_exact = Bound((old_data >> Bound_shift) & 3) == Bound::EXACT;
+                if ((e.check ^ e.value ^ old_data) == n.key && old_depth == n.depth && old_exact &&
+                    n.bound != Bound::EXACT)
+                    continue;
+            }
+            uint64_t value;
+            memcpy(&value, &n.value, sizeof(value));
+            const uint64_t data = pack(n, is_lesson);
+            e.value = value;
+            e.data = data;
+            e.check = n.key ^ value ^ data;
+        }
+        msync(map_base, map_size, MS_ASYNC);
+        flock(fd, LOCK_UN);
+#endif
+    }
+
+private:
+    // Глубина, урок, граница и лучший ход по 4 бита на координату (15 - нет хода). Граница не NONE,
+    // так что у занятой записи data не ноль
+    static uint64_t pack(const tt_entry &e, const bool is_lesson)
+    {
+        uint64_t data = uint64_t(uint8_t(e.depth) & 0x7F);
+        data |= uint64_t(is_lesson) << Lesson_shift;
+        data |= uint64_t(uint8_t(e.bound) & 3) << Bound_shift;
+        const POS_T coords[4] = {e.x, e.y, e.x2, e.y2};
+        for (int k = 0; k < 4; ++k)
+            data |= uint64_t(e.x == -1 ? 15 : coords[k] & 15) << (Move_shift + 4 * k);
+        return data;
+    }
+
+    static void unpack(const uint64_t key, const uint64_t value, const uint64_t data, tt_entry &res)
+    {
+        res.key = key;
+        memcpy(&res.value, &value, sizeof(value));
+        res.depth = int8_t(data & 0x7F);
+        res.bound = Bound((data >> Bound_shift) & 3);
+        POS_T coords[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            const int c = int((data >> (Move_shift + 4 * k)) & 15);
+            coords[k] = POS_T(c == 15 ? -1 : c);
+        }
+        res.x = coords[0];
+        res.y = coords[1];
+        res.x2 = coords[2];
+        res.y2 = coords[3];
+    }
+
+    static const int Lesson_shift = 7;
+    static const int Bound_shift = 8;
+    static const int Move_shift = 10;
+
+    int fd = -1;
+    void *map_base = nullptr;
+    size_t map_size = 0;
+    learn_entry *entries = nullptr;
+    uint64_t mask = 0;
+    uint32_t signature = 0;
+    std::mutex merge_mtx;
+};
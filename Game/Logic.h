@@ -1,99 +1,764 @@
-﻿﻿#pragma once
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <random>
+#include <unordered_map>
 #include <vector>
 
+#include "../Models/Analysis.h"
 #include "../Models/Move.h"
+#include "../Models/Project_path.h"
 #include "Board.h"
 #include "Config.h"
+#include "Eval_weights.h"
+#include "Leaf_batch.h"
+#include "Learning_hash.h"
+#include "Mcts.h"
+#include "Network.h"
+#include "Rules.h"
+#include "Solver.h"
+#include "Trace.h"
+#include "Transposition_table.h"
 
 const int INF = 1e9;
+const double Network_logit_max = 15; // ограничение логита сети, чтобы exp() не доставал до INF
+const size_t Stop_check_nodes = 1024; // как часто поиск проверяет флаг остановки и лимиты
+const int Max_iterate_depth = 64; // предел углубления для поиска без ограничения глубины
+const uint32_t History_max = 1u << 30; // порог старения истории отсечений
+const double Aspiration_window = 1.05; // окно вокруг оценки прошлой итерации: [s / w, s * w]
+const double Aspiration_max = 2; // окно шире этого - поиск без окна
+const size_t Lmr_full_moves = 3; // O2: первые ходы узла ищутся без сокращения глубины
+const int Lmr_min_depth = 3; // O2: сокращать глубину, только если до горизонта не меньше
+const double Lmr_divisor = 1.5; // O2: сокращение 1 + ln(остаток глубины) * ln(номер хода) / Lmr_divisor
+const double Futility_margin = 1.1; // O2: запас отсечения по тщетности (оценки - отношения)
+const int Lesson_depth = 100; // глубина урока "позиция проиграна": годится для поиска любой глубины
+const size_t Solver_depth_nodes = 4; // узлов решателя на поиск глубины d: Solver_depth_nodes << d, не больше Nodes
+const size_t Solver_failed_max = 4096; // нерешённых позиций в памяти решателя, затем список очищается
 
-class Logic
+// Ограничения поиска, которые может менять другой поток (GUI, протокол движка)
+struct search_limits
+{
+    atomic<bool> stop{false};       // остановить поиск
+    atomic<long long> deadline{0};  // момент остановки, steady_clock в наносекундах; 0 - без ограничения
+    atomic<size_t> max_nodes{0};    // предел узлов на поиск; 0 - без ограничения
+
+    void reset()
+    {
+        stop = false;
+        deadline = 0;
+        max_nodes = 0;
+    }
+
+    // Остановить поиск через time_ms миллисекунд от текущего момента
+    void set_time(const double time_ms)
+    {
+        auto now = chrono::steady_clock::now().time_since_epoch();
+        deadline = chrono::duration_cast<chrono::nanoseconds>(now).count() + (long long)(time_ms * 1e6);
+    }
+};
+
+// Ход партии для обучения: узел после хода color (ключ как у ребёнка корня), оценка и глубина поиска
+struct learn_record
+{
+    bool color;
+    uint64_t key;
+    double score;
+    int depth;
+};
+
+// Поиск и генерация ходов по правилам варианта Rules (Rules.h). Пачка листьев Leaf_batch и сеть
+// рассчитаны на доску 8x8, на других досках листья оцениваются по одному
+template <class Rules> class Basic_logic
 {
 public:
-    Logic(Board *board, Config *config) : board(board), config(config)
+    Basic_logic(Board *board, Config *config) : board(board), config(config)
     {
         rand_eng = std::default_random_engine (
                 !((*config)("Bot", "NoRandom")) ? unsigned(time(0)) : 0);
-        scoring_mode = (*config)("Bot", "BotScoringType");
+        const string weights_file = (*config)("Bot", "WeightsFile");
+        if (!weights_file.empty() && !tuned.load(project_path + weights_file))
+        {
+            ofstream fout(project_path + "log.txt", ios_base::app);
+            fout << "Error: can't load evaluation weights from " << project_path + weights_file
+                 << ". Using default weights\n";
+            tuned = eval_weights();
+        }
+        set_scoring_mode((*config)("Bot", "BotScoringType"));
         optimization = (*config)("Bot", "Optimization");
+        engine = (*config)("Bot", "Engine").get<string>();
+        mcts_threads = (*config)("Mcts", "Threads");
+        hash_size_mb = (*config)("Bot", "HashSizeMB");
+        if (scoring_mode == "Network" && Rules::Size != 8)
+            set_scoring_mode("NumberAndPotential"); // сеть обучена только для доски 8x8
+        if (scoring_mode == "Network")
+        {
+            string network_file = (*config)("Bot", "NetworkFile");
+            network = Network::load_shared(project_path + network_file);
+            if (!network)
+            {
+                // Без весов играем прежней оценкой, чтобы бот оставался рабочим
+                ofstream fout(project_path + "log.txt", ios_base::app);
+                fout << "Error: can't load network weights from " << project_path + network_file
+                     << ". Using NumberAndPotential\n";
+                fout.close();
+                set_scoring_mode("NumberAndPotential");
+            }
+        }
+        const string learning_file = (*config)("Learning", "File");
+        if (!learning_file.empty() && Rules::Size == 8)
+        {
+            // Оценки разных функций оценки несравнимы: подпись файла - функция оценки и веса сети
+            string signature = scoring_mode;
+            if (network)
+                signature += ":" + string((*config)("Bot", "NetworkFile"));
+            else if (tuned.mode == scoring_mode)
+                signature += ":" + weights_file;
+            learned = Learning_hash::open_shared(project_path + learning_file, (*config)("Learning", "SizeMB"),
+                                                 Learning_hash::make_signature(signature));
+            learn_min_depth = (*config)("Learning", "MinDepth");
+            if (!learned)
+            {
+                ofstream fout(project_path + "log.txt", ios_base::app);
+                fout << "Error: can't open learning file " << project_path + learning_file
+                     << " (or it was made with another BotScoringType)\n";
+            }
+        }
+        solver_max_pieces = (*config)("Solver", "MaxPieces");
+        solver_nodes = (*config)("Solver", "Nodes");
+        solver_plies = (*config)("Solver", "Plies");
+        solver.set_hash_size_mb((*config)("Solver", "HashSizeMB"));
+    }
+
+    // Начальная расстановка варианта
+    static vector<vector<POS_T>> start_mtx()
+    {
+        return Rules::start_mtx();
     }
 
     // Основная функция для поиска лучших ходов для заданного цвета
     vector<move_pos> find_best_turns(const bool color) {
-        next_move.clear(); // очищаем вектор для хранения следующего хода
-        next_best_state.clear(); // очищаем вектор для хранения следующего состояния
+        return find_best_turns(board->get_board(), color);
+    }
 
-        // Ищем лучший первый ход, передавая текущую доску, цвет
-        find_first_best_turn(board->get_board(), color, -1, -1, 0);
+    // Поиск лучших ходов на переданной доске (не требует Board, используется потоком движка)
+    vector<move_pos> find_best_turns(const vector<vector<POS_T>> &mtx, const bool color) {
+        auto lines = analyse(mtx, color, 1);
+        if (lines.empty())
+            return {}; // поиск прерван или ходов нет
+        return lines[0].turns; // последовательность ходов (цепочка ударов)
+    }
 
-        vector<move_pos> res; // итоговый вектор ходов
-        int state = 0; // начинаем с начального состояния (0)
+    // Многовариантный анализ: multi_pv лучших ходов корня (цепочки ударов целиком), лучшие первыми,
+    // с оценкой и главным вариантом. Это один поиск: каждый ход корня ищется с нижней границей,
+    // равной multi_pv-й оценке среди уже найденных, а хеш-таблица общая для всех вариантов
+    vector<analysis_line> analyse(const vector<vector<POS_T>> &mtx, const bool color, const size_t multi_pv) {
+        TRACE_SEARCH(trace);
+        nodes = 0;
+        next_check = Stop_check_nodes;
+        if (multi_pv == 1) {
+            auto solved = solve_root(mtx, color, Max_depth);
+            if (!solved.empty())
+                return solved;
+        }
+        if (engine == "MCTS")
+            return mcts_lines(mtx, color, multi_pv, nullptr);
+        return search_lines(mtx, color, multi_pv);
+    }
 
-        // Проходим по цепочке выбранных ходов до тех пор, пока не достигнем конца
-        do {
-            res.push_back(next_move[state]); // добавляем текущий ход в результат
-            state = next_best_state[state]; // переходим к следующему состоянию
-        } while (state != -1 && next_move[state].x != -1); // условие завершения (нет следующего хода или нет ударов)
+    // Итеративное углубление до max_depth: после каждой законченной глубины вызывается report.
+    // Возвращает результат последней законченной глубины (при остановке по лимитам тоже)
+    vector<analysis_line> iterate(const vector<vector<POS_T>> &mtx, const bool color, const int max_depth,
+                                  const size_t multi_pv,
+                                  const function<void(int, const vector<analysis_line> &)> &report = nullptr) {
+        TRACE_SEARCH(trace);
+        nodes = 0;
+        next_check = Stop_check_nodes;
+        if (multi_pv == 1) {
+            int plies = 0;
+            auto solved = solve_root(mtx, color, max_depth, &plies);
+            if (!solved.empty()) {
+                if (report)
+                    report(min(plies, max_depth), solved);
+                return solved;
+            }
+        }
+        if (engine == "MCTS")
+            return mcts_lines(mtx, color, multi_pv, report);
+        vector<analysis_line> best;
+        for (int depth = 0; depth <= max_depth; ++depth) {
+            Max_depth = depth;
+            auto lines = search_aspiration(mtx, color, multi_pv, best);
+            if (stopped)
+                break;
+            best = lines;
+            if (report)
+                report(depth, best);
+            if (best.empty() || best[0].score >= INF || best[0].score <= 0)
+                break; // ходов нет или результат партии уже известен
+        }
+        if (!best.empty())
+            last_score = best[0].score;
+        return best;
+    }
 
-        return res; // возвращаем последовательность ходов
+    // Очистка таблиц, живущих между поисками (новая партия)
+    void clear_tables()
+    {
+        tt.clear(); // общую таблицу сервера делят другие партии, её не трогаем
+        solver.clear();
+        solver_failed.clear();
+        if (mcts)
+            mcts->clear();
+        memset(history, 0, sizeof(history));
+        learn_pending.clear();
+        game_log.clear();
     }
 
+    // Ход партии для обучения: color сыграл turns с оценкой score поиска на глубину depth
+    void learn_turn(const vector<vector<POS_T>> &mtx, const bool color, const vector<move_pos> &turns,
+                    const double score, const int depth)
+    {
+        if (!learned || turns.empty())
+            return;
+        auto next = mtx;
+        for (auto &turn : turns)
+            next = make_turn(next, turn);
+        // Узел после хода - как ребёнок корня в поиске: ходит соперник, оценка глазами color
+        game_log.push_back({color, node_key(Zobrist::get().hash(next), !color, color, -1, -1), score, depth});
+    }
 
+    // Конец партии (result: 0 ничья, 1 победа белых, 2 победа черных, -1 не доиграна): глубокие
+    // результаты поисков партии и уроки проигравшей стороны вливаются в файл обучения.
+    // Урок: позиция после хода проигравшего не лучше оценки его следующего поиска (соперник
+    // может в неё прийти), а после последнего хода при no_moves_left - проиграна
+    void learn_game(const int result, const bool no_moves_left)
+    {
+        if (!learned)
+            return;
+        // Для каждого ключа остаётся самая глубокая запись, при равной глубине - точная, затем последняя
+        stable_sort(learn_pending.begin(), learn_pending.end(), [](const tt_entry &a, const tt_entry &b) {
+            if (a.key != b.key)
+                return a.key < b.key;
+            if (a.depth != b.depth)
+                return a.depth < b.depth;
+            return a.bound != Bound::EXACT && b.bound == Bound::EXACT;
+        });
+        vector<tt_entry> deep;
+        for (size_t k = 0; k < learn_pending.size(); ++k) {
+            if (k + 1 == learn_pending.size() || learn_pending[k + 1].key != learn_pending[k].key)
+                deep.push_back(learn_pending[k]);
+        }
+        learned->merge(deep, false);
+
+        if (result == 1 || result == 2) {
+            const bool loser = (result == 1);
+            vector<tt_entry> lessons;
+            const learn_record *prev = nullptr;
+            for (auto &rec : game_log) {
+                if (rec.color != loser)
+                    continue;
+                if (prev && rec.score < prev->score)
+                    lessons.push_back(lesson(prev->key, rec.score, rec.depth + 2));
+                prev = &rec;
+            }
+            if (prev && no_moves_left)
+                lessons.push_back(lesson(prev->key, 0, Lesson_depth));
+            learned->merge(lessons, true);
+        }
+        learn_pending.clear();
+        game_log.clear();
+    }
+
+    // Статическая оценка позиции глазами color без поиска, в шкале поиска (INF - выигрыш, 0 - проигрыш)
+    double evaluate(const vector<vector<POS_T>> &mtx, const bool color)
+    {
+        ply = 0;
+        if (network)
+        {
+            acc_stack.resize(1);
+            network->refresh(acc_stack[0], mtx);
+        }
+        return calc_score(mtx, color);
+    }
+
+    // Решение позиции df-pn не больше max_nodes узлов (горизонт - Plies секции "Solver")
+    solve_info solve(const vector<vector<POS_T>> &mtx, const bool color, const size_t max_nodes)
+    {
+        stopped = false;
+        return solver.solve(*this, mtx, color, solver_plies, max_nodes, [this]() { return check_stop(); });
+    }
 
 private:
+    // Решатель для позиции с малым числом фигур (секция "Solver"): доказанный выигрыш или проигрыш
+    // заменяет поиск, в plies - длина доказанного варианта. Пусто - позиция не решена. Узлов решателя
+    // тем больше, чем глубже поиск depth, чтобы он не стоил много больше самого поиска. Нерешённая
+    // позиция запоминается по ключу и снова решается только с большим пределом узлов
+    vector<analysis_line> solve_root(const vector<vector<POS_T>> &mtx, const bool color, const int depth,
+                                     int *plies = nullptr)
+    {
+        int pieces = 0;
+        for (auto &row : mtx)
+            pieces += int(row.size()) - int(count(row.begin(), row.end(), 0));
+        if (pieces > solver_max_pieces)
+            return {};
+        const size_t max_nodes = min(solver_nodes, Solver_depth_nodes << min(max(depth, 0), 30));
+        const uint64_t key = node_key(Zobrist::get().hash(mtx), color, color, -1, -1);
+        auto failed = solver_failed.find(key);
+        if (failed != solver_failed.end() && failed->second >= max_nodes)
+            return {};
+        auto info = solve(mtx, color, max_nodes);
+        if ((info.result != Solve_result::WIN && info.result != Solve_result::LOSS) || info.pv.empty()) {
+            if (!stopped) {
+                if (solver_failed.size() >= Solver_failed_max)
+                    solver_failed.clear();
+                solver_failed[key] = max_nodes;
+            }
+            return {};
+        }
+        analysis_line line;
+        line.turns = info.pv[0];
+        line.score = (info.result == Solve_result::WIN) ? INF : 0;
+        line.pv.assign(info.pv.begin() + 1, info.pv.end());
+        last_score = line.score;
+        if (plies)
+            *plies = info.plies;
+        return {line};
+    }
 
-    double find_first_best_turn(vector<vector<POS_T>> mtx, const bool color, const POS_T x, const POS_T y, size_t state,
-                                double alpha = -1) {
-        next_move.emplace_back(-1, -1, -1, -1); // добавляем новый элемент в вектор возможных ходов, инициализированный значениями по умолчанию
-        next_best_state.emplace_back(-1); // добавляем новое состояние, пока что -1 (конец цепочки)
+    // Поиск с окном вокруг оценки прошлой итерации prev. Оценки - отношения материала,
+    // поэтому окно мультипликативное; при выходе за окно оно расширяется до полного
+    vector<analysis_line> search_aspiration(const vector<vector<POS_T>> &mtx, const bool color, const size_t multi_pv,
+                                            const vector<analysis_line> &prev_lines) {
+        const double prev = prev_lines.empty() ? -1 : prev_lines[0].score;
+        double window = Aspiration_window;
+        double lo = -1, hi = INF + 1;
+        if (optimization != "O0" && prev > 0 && prev < INF) {
+            lo = prev / window;
+            hi = prev * window;
+        }
+        while (true) {
+            root_alpha = lo;
+            root_beta = hi;
+            auto lines = search_lines(mtx, color, multi_pv, &prev_lines);
+            root_alpha = -1;
+            root_beta = INF + 1;
+            if (stopped || lines.empty())
+                return lines;
+            // Лучший ход не хуже hi или multi_pv-й не лучше lo - оценки неточные
+            const bool fail_high = (hi <= INF && lines[0].score >= hi);
+            const bool fail_low = (lo >= 0 && lines.back().score <= lo);
+            if (!fail_high && !fail_low)
+                return lines;
+            window *= window;
+            if (fail_low)
+                lo = (window > Aspiration_max) ? -1 : prev / window;
+            if (fail_high)
+                hi = (window > Aspiration_max) ? INF + 1 : prev * window;
+        }
+    }
 
-        // Если состояние не равно 0, значит нужно искать доступные ходы для фигуры
-        if (state != 0) {
-            find_turns(x, y, mtx); // ищем допустимые ходы для текущей фигуры
+    // Один поиск на глубину Max_depth, счётчик узлов не сбрасывается
+    // prev_lines - результат прошлой итерации, его ходы корня перебираются первыми
+    vector<analysis_line> search_lines(const vector<vector<POS_T>> &mtx, const bool color, const size_t multi_pv,
+                                       const vector<analysis_line> *prev_lines = nullptr) {
+        TRACE_ZONE("search");
+        start_search(mtx);
+        find_turns(color, mtx); // ходы корня (Board мог не вызывать find_turns для этой логики)
+        if (prev_lines) {
+            for (auto it = prev_lines->rbegin(); it != prev_lines->rend(); ++it) {
+                auto pos = find(turns.begin(), turns.end(), it->turns[0]);
+                if (pos != turns.end())
+                    rotate(turns.begin(), pos, pos + 1);
+            }
         }
 
-        auto now_turns = turns; // копируем текущие возможные ходы
-        auto now_have_beats = beats; // копируем информацию о наличии ударов (битвах)
+        vector<analysis_line> lines;
+        vector<move_pos> chain;
+        search_root(mtx, color, -1, -1, chain, lines, max<size_t>(multi_pv, 1));
+        if (stopped)
+            return {}; // результат прерванного поиска не используется
+
+        // При равных оценках остаётся первый найденный ход, как и раньше
+        stable_sort(lines.begin(), lines.end(),
+                    [](const analysis_line &a, const analysis_line &b) { return a.score > b.score; });
+        if (lines.size() > multi_pv)
+            lines.resize(multi_pv);
+        if (!lines.empty())
+            last_score = lines[0].score;
+        return lines;
+    }
 
-        // Если бить нельзя и мы не в начале цепочки
-        if (!now_have_beats && state != 0) {
-            // вызываем рекурсию для другого цвета, без продолжения серии
-            return find_best_turns_rec(mtx, 1 - color, 0, alpha);
+public:
+    // Флаг остановки и лимиты поиска, проверяются каждые Stop_check_nodes узлов
+    void set_limits(const search_limits *search_limits)
+    {
+        limits = search_limits;
+    }
+
+    // Переинициализация генератора случайных чисел (воспроизводимые партии самоигры)
+    void set_seed(const unsigned seed)
+    {
+        rand_eng.seed(seed);
+    }
+
+    // Смена оценки позиции ("NumberOnly", "NumberAndPotential"), сеть задаётся только конфигом.
+    // Веса из файла Bot.WeightsFile действуют, если подобраны для этой оценки
+    void set_scoring_mode(const string &mode)
+    {
+        scoring_mode = mode;
+        weights = (tuned.mode == mode) ? tuned : eval_weights::defaults(mode);
+    }
+
+    // Смена режима поиска: "O0" - полный перебор, "O1" - альфа-бета, "O2" - выборочный поиск
+    void set_optimization(const string &mode)
+    {
+        optimization = mode;
+    }
+
+    // Тип поиска бота: "AlphaBeta" или "MCTS"
+    void set_engine(const string &type)
+    {
+        engine = type;
+    }
+
+    // Потоков на дерево MCTS вместо Mcts.Threads: логика внутри пула потоков получает свою долю ядер
+    // (ThreadPool::threads_per_task), иначе каждое дерево заняло бы все ядра
+    void set_mcts_threads(const size_t threads)
+    {
+        mcts_threads = threads;
+        mcts.reset(); // дерево создаётся заново с новым числом потоков
+    }
+
+    // Итог последнего поиска MCTS: доигровки, время, размер дерева
+    const mcts_info &get_mcts_info() const
+    {
+        return mcts_stats;
+    }
+
+    // Оценки позиций после каждого тихого хода turns из mtx (листья поиска).
+    // batched - вся пачка считается векторными ядрами Leaf_batch, иначе по одному листу через calc_score
+    void evaluate_leaves(const vector<vector<POS_T>> &mtx, const vector<move_pos> &leaf_turns, const bool first_bot_color,
+                         vector<double> &scores, const bool batched = true)
+    {
+        TRACE_ZONE("evaluate_leaves");
+        scores.resize(leaf_turns.size());
+        if (!batched || Rules::Size != 8)
+        {
+            for (size_t k = 0; k < leaf_turns.size(); ++k)
+                scores[k] = calc_score(make_turn(mtx, leaf_turns[k]), first_bot_color);
+            return;
+        }
+        uint32_t masks[4];
+        Leaf_batch::pack(mtx, masks);
+        leaf_batch.clear();
+        for (auto &turn : leaf_turns)
+            leaf_batch.push_quiet(masks, mtx[turn.x][turn.y], turn);
+        leaf_batch.count();
+        for (size_t k = 0; k < leaf_turns.size(); ++k)
+            scores[k] = score_from_counts(leaf_batch.w[k], leaf_batch.wqc[k], leaf_batch.b[k], leaf_batch.bqc[k],
+                                          leaf_batch.rw[k], leaf_batch.rb[k], first_bot_color);
+    }
+
+    // Размер хеш-таблицы поиска, память выделяется при первом поиске
+    void set_hash_size_mb(const size_t size_mb)
+    {
+        hash_size_mb = size_mb;
+        tt = Transposition_table();
+    }
+
+    // Общая хеш-таблица нескольких логик (сервер, Transposition_table::make_concurrent),
+    // nullptr - своя таблица. Номер поиска общей таблицы меняет её владелец
+    void set_shared_table(shared_ptr<Transposition_table> table)
+    {
+        shared_tt = move(table);
+    }
+
+    // Поиски логики пишут зоны в трассу, начатую Trace::start(false) (режимы с пулом потоков)
+    void set_trace(const bool on)
+    {
+        trace = on;
+    }
+
+    // Оценивает ли логика сетью (BotScoringType "Network" и веса загружены)
+    bool uses_network() const
+    {
+        return bool(network);
+    }
+
+    // Число узлов последнего поиска
+    size_t get_nodes() const
+    {
+        return nodes;
+    }
+
+    // Был ли последний поиск прерван флагом остановки
+    bool is_stopped() const
+    {
+        return stopped;
+    }
+
+private:
+    // Проверка флага остановки и лимитов, вызывается в каждом узле поиска
+    bool check_stop()
+    {
+        ++nodes;
+        if (!stopped && limits && nodes >= next_check)
+        {
+            next_check = nodes + Stop_check_nodes;
+            stopped = limits_reached(nodes);
         }
+        return stopped;
+    }
 
-        double best_score = -1; // инициализация лучшего результата (максимума)
+    // Флаг остановки или лимиты поиска исчерпаны count узлами (доигровками MCTS)
+    bool limits_reached(const size_t count) const
+    {
+        if (!limits)
+            return false;
+        const size_t max_nodes = limits->max_nodes.load(memory_order_relaxed);
+        const long long deadline = limits->deadline.load(memory_order_relaxed);
+        return limits->stop.load(memory_order_relaxed) || (max_nodes && count >= max_nodes) ||
+               (deadline && chrono::duration_cast<chrono::nanoseconds>(
+                                    chrono::steady_clock::now().time_since_epoch()).count() >= deadline);
+    }
+
+    // Поиск MCTS (Bot.Engine "MCTS", секция "Mcts"). Бюджет - лимиты поиска (время, узлы - доигровки),
+    // без них - Playouts и TimeMS. report - как у iterate, глубина - номер отчёта
+    vector<analysis_line> mcts_lines(const vector<vector<POS_T>> &mtx, const bool color, const size_t multi_pv,
+                                     const function<void(int, const vector<analysis_line> &)> &report)
+    {
+        if (!mcts)
+        {
+            Config *logic_config = config;
+            mcts = make_unique<Mcts<Basic_logic>>(
+                [logic_config]() { return make_unique<Basic_logic>(nullptr, logic_config); },
+                (*config)("Mcts", "NodePoolMB"), mcts_threads, (*config)("Mcts", "RolloutPlies"),
+                (*config)("Mcts", "Exploration"), (*config)("Mcts", "KeepTree"));
+            mcts_playouts = (*config)("Mcts", "Playouts");
+            mcts_time_ms = (*config)("Mcts", "TimeMS");
+        }
+        const bool own_budget = !limits || (!limits->deadline.load() && !limits->max_nodes.load());
+        const auto start = chrono::steady_clock::now();
+        auto stop = [&](const size_t playouts) {
+            if (limits_reached(playouts))
+                return true;
+            if (!own_budget)
+                return false;
+            return (mcts_playouts && playouts >= mcts_playouts) ||
+                   (mcts_time_ms > 0 &&
+                    chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= mcts_time_ms);
+        };
+        auto round_report = [&report](const int round, const vector<analysis_line> &lines) {
+            if (report)
+                report(round + 1, lines);
+        };
+        auto lines = mcts->search(mtx, color, multi_pv, stop, round_report, mcts_stats);
+        nodes = mcts_stats.playouts;
+        stopped = false;
+        if (!lines.empty())
+            last_score = lines[0].score;
+        return lines;
+    }
+
+    // Хеш-таблица поиска: общая, если задана, иначе своя
+    Transposition_table &table()
+    {
+        return shared_tt ? *shared_tt : tt;
+    }
+
+    // Подготовка к новому поиску с корнем mtx
+    void start_search(const vector<vector<POS_T>> &mtx)
+    {
+        stopped = false;
+        ply = 0;
+        if (network)
+        {
+            acc_stack.resize(1);
+            network->refresh(acc_stack[0], mtx); // дальше аккумулятор обновляется инкрементально
+        }
+        hash_stack.assign(1, Zobrist::get().hash(mtx));
+        if (!shared_tt)
+        {
+            if (tt.empty())
+                tt.resize(hash_size_mb);
+            tt.new_search();
+        }
+        horizon = Max_depth;
+    }
+
+    // Перебор ходов корня вместе с сериями ударов: каждая законченная цепочка - вариант анализа
+    void search_root(const vector<vector<POS_T>> &mtx, const bool color, const POS_T x, const POS_T y,
+                     vector<move_pos> &chain, vector<analysis_line> &lines, const size_t multi_pv) {
+        // Если продолжаем серию, ищем допустимые ходы для текущей фигуры
+        if (x != -1) {
+            find_turns(x, y, mtx);
+        }
+
+        auto now_turns = turns; // копируем текущие возможные ходы
+        auto now_have_beats = have_beats; // копируем информацию о наличии ударов (битвах)
+
+        // Если бить нельзя и мы не в начале цепочки - ход закончен
+        if (!now_have_beats && x != -1) {
+            if (!Rules::Promote_in_capture) {
+                search_root_line(make_series_end(mtx, x, y), color, chain, lines, multi_pv);
+                unmake_search_turn();
+                return;
+            }
+            search_root_line(mtx, color, chain, lines, multi_pv);
+            return;
+        }
 
         // Перебираем все возможные ходы
         for (auto turn : now_turns) {
-            size_t new_state = next_move.size(); // индекс нового состояния
-            double score;
-            if (now_have_beats) { // если есть возможность бить
-                // рекурсивно ищем лучший результат, продолжая серию ударов
-                score = find_first_best_turn(make_turn(mtx, turn), color, turn.x2, turn.y2, new_state, best_score);
-            } else {
-                // если бить нельзя, переходим к следующему ходу другого цвета
-                score = find_first_best_turn(make_turn(mtx, turn), 1 - color, 0, best_score);
+            chain.push_back(turn);
+            if (now_have_beats) { // если есть возможность бить, продолжаем серию ударов
+                search_root(make_search_turn(mtx, turn), color, turn.x2, turn.y2, chain, lines, multi_pv);
+            } else { // если бить нельзя, ход закончен
+                search_root_line(make_search_turn(mtx, turn), color, chain, lines, multi_pv);
             }
+            unmake_search_turn();
+            chain.pop_back();
+            if (stopped)
+                return; // результат прерванного поиска не используется
+        }
+    }
 
-            // если найден лучший результат
-            if (score > best_score) {
-                best_score = score; // обновляем лучший результат
-                next_move[state] = turn; // запоминаем ход
-                // если был удар, обновляем состояние; иначе - конец цепочки
-                next_best_state[state] = (now_have_beats ? new_state : -1);
+    // Поиск ответа соперника на законченный ход корня chain, mtx - доска после хода
+    void search_root_line(const vector<vector<POS_T>> &mtx, const bool color, const vector<move_pos> &chain,
+                          vector<analysis_line> &lines, const size_t multi_pv) {
+        // Нижняя граница: ход хуже multi_pv-го из найденных в анализ не попадёт
+        double alpha = root_alpha;
+        const double beta = root_beta;
+        const bool is_full = lines.size() >= multi_pv;
+        if (is_full) {
+            vector<double> scores;
+            for (auto &line : lines)
+                scores.push_back(line.score);
+            nth_element(scores.begin(), scores.begin() + (multi_pv - 1), scores.end(), greater<double>());
+            alpha = max(alpha, scores[multi_pv - 1]);
+        }
+        analysis_line line;
+        line.turns = chain;
+        if (optimization != "O0" && is_full) {
+            // PVS: сначала нулевое окно - лучше ли ход границы alpha
+            line.score = find_best_turns_rec(mtx, 1 - color, 0, alpha, next_up(alpha));
+            if (!stopped && line.score > alpha && line.score < beta)
+                line.score = find_best_turns_rec(mtx, 1 - color, 0, alpha, beta);
+        } else {
+            line.score = find_best_turns_rec(mtx, 1 - color, 0, alpha, beta);
+        }
+        if (stopped)
+            return;
+        if (line.score > alpha && line.score < beta) // оценка точная - главный вариант есть в хеш-таблице
+            line.pv = extract_pv(mtx, 1 - color, color);
+        lines.push_back(line);
+    }
+
+    // Главный вариант из хеш-таблицы, начиная с хода color на доске mtx (глубина 0)
+    vector<vector<move_pos>> extract_pv(vector<vector<POS_T>> mtx, bool color, const bool bot)
+    {
+        vector<vector<move_pos>> pv;
+        vector<move_pos> cur; // текущий полный ход (серия ударов)
+        board_hash hash = Zobrist::get().hash(mtx);
+        POS_T x = -1, y = -1;
+        for (int depth = 0; depth < Max_depth;) {
+            tt_entry hit;
+            const tt_entry *entry = table().probe(node_key(hash, color, bot, x, y), hit) ? &hit : nullptr;
+            if (!entry || entry->x == -1)
+                break;
+            if (x != -1) {
+                find_turns(x, y, mtx);
+            } else {
+                find_turns(color, mtx);
             }
+            const move_pos entry_turn = key_turn(move_pos(entry->x, entry->y, entry->x2, entry->y2), color);
+            auto it = find(turns.begin(), turns.end(), entry_turn);
+            if (it == turns.end())
+                break; // коллизия ключей
+            move_pos turn = *it;
+            cur.push_back(turn);
+            hash ^= Zobrist::get().delta<Rules>(mtx, turn);
+            mtx = make_turn(mtx, turn);
+            if (turn.xb != -1) {
+                find_turns(turn.x2, turn.y2, mtx);
+                if (have_beats) { // серия ударов продолжается
+                    x = turn.x2;
+                    y = turn.y2;
+                    continue;
+                }
+                hash ^= promote_after_series(mtx, turn.x2, turn.y2);
+            }
+            pv.push_back(cur);
+            cur.clear();
+            color = !color;
+            x = y = -1;
+            ++depth;
         }
-        return best_score; // возвращаем лучший найденный результат
+        return pv;
+    }
+
+    // Урок проигрыша: узел не лучше value на глубине depth
+    static tt_entry lesson(const uint64_t key, const double value, const int depth)
+    {
+        tt_entry e;
+        e.key = key;
+        e.value = value;
+        e.depth = int8_t(min(depth, Lesson_depth));
+        e.bound = Bound::UPPER;
+        return e;
+    }
+
+    // Ключ узла поиска: расстановка, сторона хода, сторона бота и фигура серии ударов. Оценка без сети
+    // симметрична относительно смены цветов, так что узел и его отражение делят одну запись
+    // хеш-таблицы и файла обучения; сеть обучена за белых, с ней ключи различаются
+    uint64_t node_key(const board_hash &hash, const bool color, const bool bot, const POS_T x, const POS_T y) const
+    {
+        return Zobrist::get().node_key(hash, color, bot, x, y, Rules::Size, !network);
+    }
+
+    // Ход записи таблицы узла с ходом color: у отражённого ключа он тоже отражён (преобразование
+    // обратно самому себе, так что годится в обе стороны)
+    move_pos key_turn(const move_pos &turn, const bool color) const
+    {
+        return (network || !color) ? turn : Zobrist::mirror_turn(turn, Rules::Size);
     }
 
     double find_best_turns_rec(vector<vector<POS_T>> mtx, const bool color, const size_t depth, double alpha = -1,
                                double beta = INF + 1, const POS_T x = -1, const POS_T y = -1) {
+        if (check_stop())
+            return 0;
         // Если достигнута максимальная глубина поиска
-        if (depth == Max_depth) {
+        if (int(depth) == horizon) {
             return calc_score(mtx, (depth % 2 == color)); // оцениваем текущую доску
         }
 
+        // Хеш-таблица: готовый результат узла или хотя бы лучший ход для сортировки
+        const bool use_tt = (optimization != "O0");
+        const bool selective = (optimization == "O2"); // сокращения, отсечение по тщетности
+        const int remaining = horizon - int(depth);
+        const uint64_t key = node_key(hash_stack[ply], color, (depth % 2 ? color : !color), x, y);
+        tt_entry hit;
+        const tt_entry *entry = (use_tt && table().probe(key, hit)) ? &hit : nullptr;
+        // Второй уровень - файл обучения: записи прошлых партий, не мельче оставшейся глубины
+        // (более глубокая при O1 даёт только лучший ход для сортировки)
+        tt_entry learned_entry;
+        if (use_tt && learned && (!entry || entry->depth < remaining) && learned->probe(key, learned_entry) &&
+            learned_entry.depth >= remaining)
+            entry = &learned_entry;
+        // Только записи той же глубины: более глубокие меняли бы результат в зависимости от порядка обхода.
+        // Выборочному поиску O2 точность не обещана, ему годятся и более глубокие
+        if (entry && (entry->depth == remaining || (selective && entry->depth > remaining))) {
+            if (entry->bound == Bound::EXACT || (entry->bound == Bound::LOWER && entry->value >= beta) ||
+                (entry->bound == Bound::UPPER && entry->value <= alpha))
+                return entry->value;
+        }
+        const double alpha_start = alpha, beta_start = beta;
+
         // Если есть серия ударов (x,y заданы)
         if (x != -1) {
             find_turns(x, y, mtx); // ищем ходы для фигуры в позиции (x,y)
@@ -102,10 +767,15 @@ private:
         }
 
         auto now_turns = turns; // копируем возможные ходы
-        auto now_have_beats = heve_beats; // копируем информацию о наличии ударов
+        auto now_have_beats = have_beats; // копируем информацию о наличии ударов
 
         // Если ударов сделать нельзя и есть серия ударов
         if (!now_have_beats && x != -1) {
+            if (!Rules::Promote_in_capture) {
+                const double score = find_best_turns_rec(make_series_end(mtx, x, y), 1 - color, depth + 1, alpha, beta);
+                unmake_search_turn();
+                return score;
+            }
             // рекурсия для другого цвета и увеличенной глубины
             return find_best_turns_rec(mtx, 1 - color, depth + 1, alpha, beta);
         }
@@ -115,20 +785,85 @@ private:
             return (depth % 2 ? 0 : INF); // 0 если ходит противник, INF если свой ход
         }
 
+        // Тихие ходы сортируем по истории отсечений, лучший ход из таблицы перебираем первым
+        if (!now_have_beats && use_tt && remaining > 1) {
+            stable_sort(now_turns.begin(), now_turns.end(), [this, color](const move_pos &a, const move_pos &b) {
+                return history_score(color, a) > history_score(color, b);
+            });
+        }
+        if (entry && entry->x != -1) {
+            auto it = find(now_turns.begin(), now_turns.end(),
+                           key_turn(move_pos(entry->x, entry->y, entry->x2, entry->y2), color));
+            if (it != now_turns.end())
+                rotate(now_turns.begin(), it, it + 1);
+        }
+
+        // Узел перед горизонтом: все дети - листья, оцениваем их одной пачкой
+        const bool is_frontier = !now_have_beats && remaining == 1 && !network && Rules::Size == 8;
+        vector<double> leaf_scores;
+        if (is_frontier) {
+            nodes += now_turns.size() - 1; // листья пачки тоже узлы, один учтёт check_stop
+            if (check_stop())
+                return 0;
+            evaluate_leaves(mtx, now_turns, ((depth + 1) % 2 == size_t(1 - color)), leaf_scores);
+        }
+
         double min_score = INF + 1; // минимальный возможный результат
         double max_score = -1; // максимальный возможный результат
+        size_t best_k = 0; // индекс лучшего хода узла
 
         // Перебираем все возможные ходы
-        for (auto turn : now_turns) {
+        for (size_t k = 0; k < now_turns.size(); ++k) {
+            const auto &turn = now_turns[k];
             double score;
-            if (now_have_beats) { // если есть удар
-                score = find_best_turns_rec(make_turn(mtx, turn), color, depth, alpha, beta, turn.x2, turn.y2);
+            // O2, отсечение по тщетности за два полухода до горизонта: ответ соперника и лист
+            // почти не меняют оценку тихого хода, поэтому ход, статическая оценка которого с запасом
+            // Futility_margin не дотягивает до alpha (для минимизатора - не опускается до beta), не ищем
+            if (selective && !now_have_beats && remaining == 2 && k > 0 && !network) {
+                const double quiet = calc_score(make_turn(mtx, turn), (depth % 2 == color));
+                if (depth % 2 ? quiet * Futility_margin <= alpha : quiet / Futility_margin >= beta)
+                    continue;
+            }
+            // O2, сокращение поздних ходов: тихий ход после первых Lmr_full_moves сначала ищется
+            // мельче с нулевым окном и полностью - только если оказался лучше границы. Чем дальше
+            // ход в порядке перебора и чем больше глубина, тем сильнее сокращение
+            if (selective && !now_have_beats && k >= Lmr_full_moves && remaining >= Lmr_min_depth) {
+                const int reduction =
+                    min(remaining - 1, 1 + int(log(double(remaining)) * log(double(k)) / Lmr_divisor));
+                horizon -= reduction;
+                score = (depth % 2) ? search_child(mtx, turn, color, depth, false, alpha, next_up(alpha))
+                                    : search_child(mtx, turn, color, depth, false, next_down(beta), beta);
+                horizon += reduction;
+                if (stopped)
+                    return 0;
+                if (depth % 2 ? score <= alpha : score >= beta)
+                    continue;
+            }
+            if (is_frontier) {
+                score = leaf_scores[k]; // оценка листа уже посчитана пачкой
+            } else if (use_tt && k > 0) {
+                // PVS: остальные ходы сначала проверяем нулевым окном - окном в один шаг double у границы
+                // alpha (beta для минимизатора). Ход лучше границы - ищем его заново с полным окном
+                if (depth % 2) {
+                    score = search_child(mtx, turn, color, depth, now_have_beats, alpha, next_up(alpha));
+                    if (!stopped && score > alpha && score < beta)
+                        score = search_child(mtx, turn, color, depth, now_have_beats, alpha, beta);
+                } else {
+                    score = search_child(mtx, turn, color, depth, now_have_beats, next_down(beta), beta);
+                    if (!stopped && score < beta && score > alpha)
+                        score = search_child(mtx, turn, color, depth, now_have_beats, alpha, beta);
+                }
+                if (stopped)
+                    return 0;
             } else {
-                // если ударов нет, переходим к следующему ходу другого игрока
-                score = find_best_turns_rec(make_turn(mtx, turn), 1 - color, depth + 1, alpha, beta);
+                score = search_child(mtx, turn, color, depth, now_have_beats, alpha, beta);
+                if (stopped)
+                    return 0;
             }
 
             // обновляем минимальный и максимальный результаты
+            if (depth % 2 ? score > max_score : score < min_score)
+                best_k = k;
             min_score = min(min_score, score);
             max_score = max(max_score, score);
 
@@ -138,51 +873,161 @@ private:
                 beta = min(beta, min_score); // обновляем правую границу
             }
 
-            // если отсечение по альфа-бета
-            if (optimization != 'O0' && alpha > beta) {
+            // если отсечение по альфа-бета (оценка на границе окна - тоже отсечение, как в нулевом окне)
+            if (optimization != "O0" && alpha >= beta) {
+                if (turn.xb == -1)
+                    add_history(color, turn, remaining);
                 break; // выходим из цикла
             }
-            // при равенстве границ, можем вернуть приближённое значение
-            if (optimization == 'O2' && alpha == beta) {
-                return (depth % 2 ? max_score + 1 : min_score - 1);
-            }
         }
 
         // возвращаем результат в зависимости от текущей глубины
-        return (depth % 2 ? max_score : min_score);
+        const double result = (depth % 2 ? max_score : min_score);
+        if (use_tt) {
+            Bound bound = Bound::EXACT;
+            if (result <= alpha_start)
+                bound = Bound::UPPER;
+            else if (result >= beta_start)
+                bound = Bound::LOWER;
+            const move_pos best = key_turn(now_turns[best_k], color);
+            table().store(key, result, remaining, bound, &best);
+            if (learned && remaining >= learn_min_depth) {
+                // Глубокий результат - кандидат в файл обучения в конце партии
+                tt_entry deep;
+                deep.key = key;
+                deep.value = result;
+                deep.depth = int8_t(remaining);
+                deep.bound = bound;
+                deep.x = best.x;
+                deep.y = best.y;
+                deep.x2 = best.x2;
+                deep.y2 = best.y2;
+                learn_pending.push_back(deep);
+            }
+        }
+        return result;
     }
 
-    //выполняет ход на копии доски и возвращает доску после хода
-    vector<vector<POS_T>> make_turn(vector<vector<POS_T>> mtx, move_pos turn) const
+    // Соседние значения double: нулевое окно поиска (alpha, next_up(alpha))
+    static double next_up(const double x)
     {
-        if (turn.xb != -1)
-            mtx[turn.xb][turn.yb] = 0;
-        if ((mtx[turn.x][turn.y] == 1 && turn.x2 == 0) || (mtx[turn.x][turn.y] == 2 && turn.x2 == 7))
-            mtx[turn.x][turn.y] += 2;
-        mtx[turn.x2][turn.y2] = mtx[turn.x][turn.y];
-        mtx[turn.x][turn.y] = 0;
+        return nextafter(x, double(INF + 1));
+    }
+    static double next_down(const double x)
+    {
+        return nextafter(x, -1.0);
+    }
+
+    // Поиск после хода turn: продолжение серии ударов той же фигурой или ход соперника
+    double search_child(const vector<vector<POS_T>> &mtx, const move_pos &turn, const bool color, const size_t depth,
+                        const bool is_beat, const double alpha, const double beta)
+    {
+        double score;
+        if (is_beat) { // если есть удар
+            score = find_best_turns_rec(make_search_turn(mtx, turn), color, depth, alpha, beta, turn.x2, turn.y2);
+        } else {
+            // если ударов нет, переходим к следующему ходу другого игрока
+            score = find_best_turns_rec(make_search_turn(mtx, turn), 1 - color, depth + 1, alpha, beta);
+        }
+        unmake_search_turn();
+        return score;
+    }
+
+    // Оценка тихого хода по истории отсечений
+    uint32_t history_score(const bool color, const move_pos &turn) const
+    {
+        return history[color][Rules::index(turn.x, turn.y)][Rules::index(turn.x2, turn.y2)];
+    }
+
+    // Тихий ход turn дал отсечение на оставшейся глубине remaining
+    void add_history(const bool color, const move_pos &turn, const int remaining)
+    {
+        uint32_t &h = history[color][Rules::index(turn.x, turn.y)][Rules::index(turn.x2, turn.y2)];
+        h += uint32_t(remaining * remaining);
+        if (h > History_max)
+        {
+            // Старение: старые отсечения весят меньше новых
+            for (auto &side : history)
+                for (auto &from : side)
+                    for (auto &v : from)
+                        v /= 2;
+        }
+    }
+
+    // ход внутри поиска: копия доски и инкрементальное обновление аккумулятора сети
+    vector<vector<POS_T>> make_search_turn(const vector<vector<POS_T>> &mtx, const move_pos &turn)
+    {
+        if (network)
+        {
+            if (ply + 1 == acc_stack.size())
+                acc_stack.emplace_back();
+            network->update(acc_stack[ply], acc_stack[ply + 1], mtx, turn);
+        }
+        if (ply + 1 == hash_stack.size())
+            hash_stack.emplace_back();
+        hash_stack[ply + 1] = hash_stack[ply] ^ Zobrist::get().delta<Rules>(mtx, turn);
+        ++ply;
+        return make_turn(mtx, turn);
+    }
+
+    // конец серии ударов фигурой (x, y) внутри поиска: превращение по правилам без превращения
+    // посреди серии, отменяется как ход через unmake_search_turn
+    vector<vector<POS_T>> make_series_end(vector<vector<POS_T>> mtx, const POS_T x, const POS_T y)
+    {
+        if (ply + 1 == hash_stack.size())
+            hash_stack.emplace_back();
+        hash_stack[ply + 1] = hash_stack[ply] ^ promote_after_series(mtx, x, y);
+        ++ply;
         return mtx;
     }
+
+    // отмена хода поиска: аккумулятор родителя лежит в стеке ниже
+    void unmake_search_turn()
+    {
+        --ply;
+    }
+
     // оценивает состояние доски для бота
     double calc_score(const vector<vector<POS_T>> &mtx, const bool first_bot_color) const
     {
+        TRACE_ZONE("calc_score");
         // color - who is max player
-        double w = 0, wq = 0, b = 0, bq = 0;
-        for (POS_T i = 0; i < 8; ++i)
+        int w = 0, wq = 0, b = 0, bq = 0, rw = 0, rb = 0;
+        for (POS_T i = 0; i < Rules::Size; ++i)
         {
-            for (POS_T j = 0; j < 8; ++j)
+            for (POS_T j = 0; j < Rules::Size; ++j)
             {
                 w += (mtx[i][j] == 1); // всего белых пешек
                 wq += (mtx[i][j] == 3); //      белых королев
                 b += (mtx[i][j] == 2); //       черных пешек
                 bq += (mtx[i][j] == 4); //      черных королев
-                if (scoring_mode == "NumberAndPotential")
-                {
-                    w += 0.05 * (mtx[i][j] == 1) * (7 - i);
-                    b += 0.05 * (mtx[i][j] == 2) * (i);
-                }
+                rw += (mtx[i][j] == 1) * i; // суммы номеров строк пешек
+                rb += (mtx[i][j] == 2) * i;
             }
         }
+        if (network && w + wq != 0 && b + bq != 0)
+        {
+            // Сеть оценивает за белых; exp переводит логит в ту же шкалу отношений (1 - равенство)
+            double logit = network->evaluate(acc_stack[ply]);
+            if (first_bot_color)
+                logit = -logit;
+            return exp(max(-Network_logit_max, min(Network_logit_max, logit)));
+        }
+        return score_from_counts(w, wq, b, bq, rw, rb, first_bot_color);
+    }
+
+    // оценка по количествам фигур и суммам номеров строк пешек (общая для листа и пачки листьев)
+    double score_from_counts(const int cw, const int cwq, const int cb, const int cbq, const int rw, const int rb,
+                             const bool first_bot_color) const
+    {
+        double w = cw, wq = cwq, b = cb, bq = cbq;
+        if (weights.advance != 0)
+        {
+            w += weights.advance * ((Rules::Size - 1) * cw - rw); // продвижение белых пешек к строке 0
+            b += weights.advance * rb; //                           черных к последней строке
+        }
+        // Оценка за другой цвет - оценка отражённой позиции (цвета поменяны, доска повёрнута): счёты
+        // меняются местами. На этой симметрии держатся общие ключи узла и его отражения (node_key)
         if (!first_bot_color)
         {
             swap(b, w);
@@ -192,12 +1037,7 @@ private:
             return INF;
         if (b + bq == 0)
             return 0;
-        int q_coef = 4; // вес королевы
-        if (scoring_mode == "NumberAndPotential")
-        {
-            q_coef = 5;
-        }
-        return (b + bq * q_coef) / (w + wq * q_coef);
+        return (b + bq * weights.king) / (w + wq * weights.king);
     }
 
 public:
@@ -212,19 +1052,41 @@ public:
         find_turns(x, y, board->get_board());
     }
 
-private:
+    //выполняет ход на копии доски и возвращает доску после хода
+    vector<vector<POS_T>> make_turn(vector<vector<POS_T>> mtx, move_pos turn) const
+    {
+        TRACE_ZONE("make_turn");
+        if (turn.xb != -1)
+            mtx[turn.xb][turn.yb] = 0;
+        // Без превращения посреди серии (Promote_in_capture) ударившая шашка превращается в конце серии
+        if (turn.x2 == Rules::Promotion_row[mtx[turn.x][turn.y]] && (Rules::Promote_in_capture || turn.xb == -1))
+            mtx[turn.x][turn.y] += 2;
+        mtx[turn.x2][turn.y2] = mtx[turn.x][turn.y];
+        mtx[turn.x][turn.y] = 0;
+        return mtx;
+    }
+
+    // конец хода, последний шаг которого last: шашка, закончившая серию ударов на последней строке,
+    // превращается, если по правилам не превратилась посреди серии. Нужен после make_turn последнего
+    // шага хода вне поиска
+    void finish_series(vector<vector<POS_T>> &mtx, const move_pos &last) const
+    {
+        promote_after_series(mtx, last.x2, last.y2);
+    }
+
     //основной метод для поиска возможных ходов на доске
     void find_turns(const bool color, const vector<vector<POS_T>> &mtx)
     {
+        TRACE_ZONE("find_turns");
         vector<move_pos> res_turns;
         bool have_beats_before = false;
-        for (POS_T i = 0; i < 8; ++i)
+        for (POS_T i = 0; i < Rules::Size; ++i)
         {
-            for (POS_T j = 0; j < 8; ++j)
+            for (POS_T j = 0; j < Rules::Size; ++j)
             {
                 if (mtx[i][j] && mtx[i][j] % 2 != color)
                 {
-                    find_turns(i, j, mtx);
+                    find_piece_turns(i, j, mtx);
                     if (have_beats && !have_beats_before)
                     {
                         have_beats_before = true;
@@ -238,11 +1100,23 @@ private:
             }
         }
         turns = res_turns;
-        shuffle(turns.begin(), turns.end(), rand_eng);
         have_beats = have_beats_before;
+        if (Rules::Capture_majority && have_beats)
+            keep_longest_series(mtx);
+        shuffle(turns.begin(), turns.end(), rand_eng);
     }
     // ищет возможные ходы для указанной фигуры на переданной доске
     void find_turns(const POS_T x, const POS_T y, const vector<vector<POS_T>> &mtx)
+    {
+        TRACE_ZONE("find_turns");
+        find_piece_turns(x, y, mtx);
+        if (Rules::Capture_majority && have_beats)
+            keep_longest_series(mtx);
+    }
+
+private:
+    // Ходы фигуры без правила большинства
+    void find_piece_turns(const POS_T x, const POS_T y, const vector<vector<POS_T>> &mtx)
     {
         turns.clear();
         have_beats = false;
@@ -257,7 +1131,7 @@ private:
                 {
                     for (POS_T j = y - 2; j <= y + 2; j += 4)
                     {
-                        if (i < 0 || i > 7 || j < 0 || j > 7)
+                        if (i < 0 || i >= Rules::Size || j < 0 || j >= Rules::Size)
                             continue;
                         POS_T xb = (x + i) / 2, yb = (y + j) / 2;
                         if (mtx[i][j] || !mtx[xb][yb] || mtx[xb][yb] % 2 == type % 2)
@@ -273,7 +1147,7 @@ private:
                     for (POS_T j = -1; j <= 1; j += 2)
                     {
                         POS_T xb = -1, yb = -1;
-                        for (POS_T i2 = x + i, j2 = y + j; i2 != 8 && j2 != 8 && i2 != -1 && j2 != -1; i2 += i, j2 += j)
+                        for (POS_T i2 = x + i, j2 = y + j; i2 != Rules::Size && j2 != Rules::Size && i2 != -1 && j2 != -1; i2 += i, j2 += j)
                         {
                             if (mtx[i2][j2])
                             {
@@ -288,6 +1162,9 @@ private:
                             {
                                 turns.emplace_back(x, y, i2, j2, xb, yb);
                             }
+                            // Недальнобойная дамка бьёт только соседнюю фигуру на соседнее за ней поле
+                            if (!Rules::Flying_kings && (xb == -1 || xb != i2))
+                                break;
                         }
                     }
                 }
@@ -308,7 +1185,7 @@ private:
                 POS_T i = ((type % 2) ? x - 1 : x + 1);
                 for (POS_T j = y - 1; j <= y + 1; j += 2)
                 {
-                    if (i < 0 || i > 7 || j < 0 || j > 7 || mtx[i][j])
+                    if (i < 0 || i >= Rules::Size || j < 0 || j >= Rules::Size || mtx[i][j])
                         continue;
                     turns.emplace_back(x, y, i, j);
                 }
@@ -320,11 +1197,13 @@ private:
                 {
                     for (POS_T j = -1; j <= 1; j += 2)
                     {
-                        for (POS_T i2 = x + i, j2 = y + j; i2 != 8 && j2 != 8 && i2 != -1 && j2 != -1; i2 += i, j2 += j)
+                        for (POS_T i2 = x + i, j2 = y + j; i2 != Rules::Size && j2 != Rules::Size && i2 != -1 && j2 != -1; i2 += i, j2 += j)
                         {
                             if (mtx[i2][j2])
                                 break;
                             turns.emplace_back(x, y, i2, j2);
+                            if (!Rules::Flying_kings)
+                                break;
                         }
                     }
                 }
@@ -332,17 +1211,99 @@ private:
         }
     }
 
+    // Правило большинства: из ударов turns остаются начинающие самые длинные серии
+    void keep_longest_series(const vector<vector<POS_T>> &mtx)
+    {
+        auto now_turns = turns;
+        vector<int> lengths;
+        int longest = 0;
+        for (auto &turn : now_turns)
+        {
+            lengths.push_back(1 + series_length(make_turn(mtx, turn), turn.x2, turn.y2));
+            longest = max(longest, lengths.back());
+        }
+        turns.clear();
+        for (size_t k = 0; k < now_turns.size(); ++k)
+        {
+            if (lengths[k] == longest)
+                turns.push_back(now_turns[k]);
+        }
+        have_beats = true;
+    }
+
+    // Число ударов самой длинной серии, которую может продолжить фигура (x, y)
+    int series_length(const vector<vector<POS_T>> &mtx, const POS_T x, const POS_T y)
+    {
+        find_piece_turns(x, y, mtx);
+        if (!have_beats)
+            return 0;
+        auto now_turns = turns;
+        int res = 0;
+        for (auto &turn : now_turns)
+            res = max(res, 1 + series_length(make_turn(mtx, turn), turn.x2, turn.y2));
+        return res;
+    }
+
+    // Превращение шашки (x, y), закончившей серию ударов на последней строке, если по правилам
+    // посреди серии она не превращается. Возвращает изменение хеша расстановки
+    board_hash promote_after_series(vector<vector<POS_T>> &mtx, const POS_T x, const POS_T y) const
+    {
+        if (Rules::Promote_in_capture || x != Rules::Promotion_row[mtx[x][y]])
+            return {};
+        const Zobrist &keys = Zobrist::get();
+        const board_hash d = keys.piece_key(mtx[x][y], x, y, Rules::Size) ^ keys.piece_key(mtx[x][y] + 2, x, y, Rules::Size);
+        mtx[x][y] += 2;
+        return d;
+    }
+
 public:
     vector<move_pos> turns; //возможные ходы
     bool have_beats; // флаг обязательного взятия шашки
     int Max_depth; // максимальная глубина поиска ходов
+    double last_score = 0; // оценка последнего find_best_turns с точки зрения ходящего
 
 private:
     default_random_engine rand_eng; // генератор случайных чисел
     string scoring_mode;
+    eval_weights weights; // веса оценки по количеству фигур для scoring_mode
+    eval_weights tuned; // веса из файла Bot.WeightsFile, mode пуст - файла нет
+    Leaf_batch leaf_batch; // пачка листьев узла перед горизонтом
+    shared_ptr<const Network> network; // сеть оценки для BotScoringType "Network"
+    vector<network_accumulator> acc_stack; // аккумуляторы сети по глубине текущего пути поиска
+    size_t ply = 0; // число ходов от корня на текущем пути поиска
+    int horizon = 0; // глубина листьев: Max_depth, меньше внутри сокращённого поиска (O2)
     string optimization; // оценка позиции бота
-    vector<move_pos> next_move; // лучшие ходы
-    vector<int> next_best_state; // состояние после выполненого хода
+    Transposition_table tt; // хеш-таблица поиска, живёт между поисками
+    shared_ptr<Transposition_table> shared_tt; // общая таблица сервера вместо tt, nullptr - нет
+    size_t hash_size_mb = 16; // размер хеш-таблицы
+    vector<board_hash> hash_stack; // хеши расстановки (и её отражения) по глубине текущего пути поиска
+    double root_alpha = -1, root_beta = INF + 1; // окно корня (окно стремления итеративного поиска)
+    const search_limits *limits = nullptr; // флаг остановки и лимиты поиска (владелец - Engine)
+    size_t next_check = Stop_check_nodes; // узел следующей проверки лимитов
+    uint32_t history[2][Rules::Squares][Rules::Squares] = {}; // история отсечений тихих ходов [цвет][откуда][куда]
+    bool stopped = false; // поиск прерван
+    size_t nodes = 0; // счётчик узлов текущего поиска
+    shared_ptr<Learning_hash> learned; // файл обучения (секция "Learning"), nullptr - выключен
+    int learn_min_depth = 4; // в файл идут результаты не мельче этой оставшейся глубины
+    vector<tt_entry> learn_pending; // глубокие результаты поисков текущей партии
+    vector<learn_record> game_log; // ходы текущей партии для уроков проигрыша
+    Solver solver; // решатель эндшпиля df-pn, таблица живёт между поисками
+    int solver_max_pieces = 0; // решать позиции, где фигур не больше; 0 - решатель выключен
+    size_t solver_nodes = 0; // предел узлов решателя на поиск
+    int solver_plies = 60; // горизонт доказательства в полуходах
+    unordered_map<uint64_t, size_t> solver_failed; // нерешённые позиции: ключ -> предел узлов неудачной попытки
+    string engine = "AlphaBeta"; // тип поиска (Bot.Engine)
+    unique_ptr<Mcts<Basic_logic>> mcts; // дерево MCTS, создаётся при первом поиске
+    size_t mcts_threads = 0; // потоков на дерево, 0 - по числу ядер
+    size_t mcts_playouts = 0; // доигровок на ход без лимитов поиска, 0 - без ограничения
+    double mcts_time_ms = 0; // время хода без лимитов поиска, 0 - без ограничения
+    mcts_info mcts_stats;
+    bool trace = false; // поиски пишут зоны в трассу Trace::start(false)
     Board *board; // указатель на Board
     Config *config; // указатель на Config
 };
+
+// Логика русских шашек: игра, движок, самоигра и анализ
+using Logic = Basic_logic<Russian_rules>;
+// Логика международных шашек 10x10
+using International_logic = Basic_logic<International_rules>;
@@ -0,0 +1,656 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#ifndef _WIN32
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "../Models/Pdn_game.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "Pdn_file.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Игрок матча: по позиции возвращает запись хода ("c3-d4", "c3:e5:g3"), пустая строка - хода нет
+// (процесс движка упал или ответил "bestmove none")
+class Match_player
+{
+public:
+    virtual ~Match_player() = default;
+    virtual void new_game() = 0;
+    virtual string best_move(const vector<vector<POS_T>> &mtx, const bool color) = 0;
+
+    // Следующие поиски пишут зоны в трассу (только движок в этом же процессе)
+    virtual void set_trace(const bool)
+    {
+    }
+};
+
+// Движок в этом же процессе: своя логика с настройками бота стороны матча
+class Logic_player : public Match_player
+{
+public:
+    Logic_player(Config *config, const int level, const double time_ms, const unsigned seed,
+                 const size_t mcts_threads)
+        : logic(nullptr, config), level(level), time_ms(time_ms)
+    {
+        logic.set_seed(seed);
+        logic.set_mcts_threads(mcts_threads);
+    }
+
+    void new_game() override
+    {
+        logic.clear_tables();
+    }
+
+    void set_trace(const bool on) override
+    {
+        logic.set_trace(on);
+    }
+
+    string best_move(const vector<vector<POS_T>> &mtx, const bool color) override
+    {
+        vector<move_pos> turns;
+        if (time_ms > 0)
+        {
+            limits.reset();
+            limits.set_time(time_ms);
+            logic.set_limits(&limits);
+            auto lines = logic.iterate(mtx, color, Max_iterate_depth, 1);
+            logic.set_limits(nullptr);
+            if (!lines.empty())
+                turns = lines[0].turns;
+        }
+        else
+        {
+            logic.Max_depth = level;
+            turns = logic.find_best_turns(mtx, color);
+        }
+        if (turns.empty())
+        {
+            // Время вышло раньше первой глубины: любой допустимый ход
+            auto legal = Notation::legal_turns(logic, mtx, color);
+            if (!legal.empty())
+                turns = legal[0];
+        }
+        return turns.empty() ? "" : Notation::turn_name(turns);
+    }
+
+private:
+    Logic logic;
+    search_limits limits;
+    int level;
+    double time_ms; // время на ход, 0 - поиск на глубину level
+};
+
+#ifndef _WIN32
+// Внешний движок (например, другая сборка): процесс command с протоколом режима engine
+// на stdin/stdout. Позиция передаётся FEN перед каждым ходом
+class Process_player : public Match_player
+{
+public:
+    Process_player(const string &command, const int level, const double time_ms) : level(level), time_ms(time_ms)
+    {
+        // Запуск под общим замком: каналы другой партии не должны попасть в этот процесс
+        static mutex start_mtx;
+        lock_guard<mutex> lock(start_mtx);
+        int to_child[2], from_child[2];
+        if (pipe(to_child) != 0)
+            throw runtime_error("can't create pipe for " + command);
+        if (pipe(from_child) != 0)
+        {
+            close(to_child[0]);
+            close(to_child[1]);
+            throw runtime_error("can't create pipe for " + command);
+        }
+        const char *cmd = command.c_str();
+        pid = fork();
+        if (pid == 0)
+        {
+            dup2(to_child[0], STDIN_FILENO);
+            dup2(from_child[1], STDOUT_FILENO);
+            close(to_child[0]);
+            close(to_child[1]);
+            close(from_child[0]);
+            close(from_child[1]);
+            execl("/bin/sh", "sh", "-c", cmd, (char *)nullptr);
+            _exit(127);
+        }
+        close(to_child[0]);
+        close(from_child[1]);
+        if (pid < 0)
+        {
+            close(to_child[1]);
+            close(from_child[0]);
+            throw runtime_error("can't start " + command);
+        }
+        fcntl(to_child[1], F_SETFD, FD_CLOEXEC);
+        fcntl(from_child[0], F_SETFD, FD_CLOEXEC);
+        in = fdopen(to_child[1], "w");
+        out = fdopen(from_child[0], "r");
+    }
+
+    ~Process_player() override
+    {
+        send("quit");
+        fclose(in);
+        fclose(out);
+        waitpid(pid, nullptr, 0);
+    }
+
+    void new_game() override
+    {
+        send("newgame");
+        send("isready");
+        string line;
+        while (read_line(line) && line != "readyok")
+        {
+        }
+    }
+
+    string best_move(const vector<vector<POS_T>> &mtx, const bool color) override
+    {
+        send("position fen " + Notation::fen(mtx, color));
+        send(time_ms > 0 ? "go movetime " + to_string(int(time_ms)) : "go depth " + to_string(level));
+        string line;
+        while (read_line(line))
+        {
+            if (line.compare(0, 9, "bestmove ") != 0)
+                continue; // строки info
+            string move = line.substr(9, line.find(' ', 9) - 9);
+            return move == "none" ? "" : move;
+        }
+        return ""; // процесс закрыл вывод
+    }
+
+private:
+    void send(const string &s)
+    {
+        fputs((s + "\n").c_str(), in);
+        fflush(in);
+    }
+
+    // Следующая строка ответа, false - конец вывода процесса
+    bool read_line(string &line)
+    {
+        line.clear();
+        int c;
+        while ((c = fgetc(out)) != EOF && c != '\n')
+            line += char(c);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        return c != EOF || !line.empty();
+    }
+
+    pid_t pid = -1;
+    FILE *in = nullptr;  // stdin движка
+    FILE *out = nullptr; // stdout движка
+    int level;
+    double time_ms;
+};
+#endif
+
+// Последовательный тест отношения правдоподобия (SPRT) по итогам партий: H0 - первый движок
+// сильнее на elo0, H1 - на elo1. Логарифм отношения правдоподобия считается в нормальном
+// приближении по среднему и дисперсии очков за партию, границы - по ошибкам alpha и beta
+struct sprt_test
+{
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05; // вероятность принять H1, когда верна H0
+    double beta = 0.05;  // вероятность принять H0, когда верна H1
+
+    // Ниже этой границы принимается H0
+    double lower() const
+    {
+        return log(beta / (1 - alpha));
+    }
+
+    // Выше этой границы принимается H1
+    double upper() const
+    {
+        return log((1 - beta) / alpha);
+    }
+
+    double llr(const size_t wins, const size_t draws, const size_t losses) const
+    {
+        const double n = double(wins + draws + losses);
+        const double var = variance(wins, draws, losses);
+        if (var <= 0)
+            return 0; // все партии с одним итогом: оценить разброс нельзя
+        const double s = score(wins, draws, losses);
+        const double s0 = elo_score(elo0), s1 = elo_score(elo1);
+        return n * (s1 - s0) * (2 * s - s0 - s1) / (2 * var);
+    }
+
+    // Доля очков первого движка
+    static double score(const size_t wins, const size_t draws, const size_t losses)
+    {
+        const double n = double(wins + draws + losses);
+        return n > 0 ? (wins + draws / 2.0) / n : 0.5;
+    }
+
+    // Дисперсия очков одной партии
+    static double variance(const size_t wins, const size_t draws, const size_t losses)
+    {
+        const double n = double(wins + draws + losses);
+        if (n == 0)
+            return 0;
+        const double s = score(wins, draws, losses);
+        return (wins + draws / 4.0) / n - s * s;
+    }
+
+    static double elo_score(const double elo)
+    {
+        return 1 / (1 + pow(10, -elo / 400));
+    }
+
+    static double score_elo(double s)
+    {
+        s = min(max(s, 1e-6), 1 - 1e-6);
+        return -400 * log10(1 / s - 1);
+    }
+};
+
+// Матч двух движков (режим "Checkers match"): движки - настройки бота этой сборки или внешние
+// программы с протоколом engine. Партии идут парами из одного дебюта со сменой цветов,
+// пары играются параллельно на пуле потоков. Явно решённые партии присуждаются досрочно,
+// матч останавливается, как только SPRT принял одну из гипотез
+class Match
+{
+public:
+    Match(Config *config) : config(config)
+    {
+    }
+
+    int run()
+    {
+        const size_t threads = (*config)("Match", "Threads");
+        const size_t max_games = (*config)("Match", "MaxGames");
+        const string pdn_file = (*config)("Match", "PdnFile");
+        seed = (*config)("Match", "Seed");
+        sprt.elo0 = (*config)("Match", "Elo0");
+        sprt.elo1 = (*config)("Match", "Elo1");
+        sprt.alpha = (*config)("Match", "Alpha");
+        sprt.beta = (*config)("Match", "Beta");
+        for (int k = 0; k < 2; ++k)
+        {
+            if (!load_engine(k ? "EngineB" : "EngineA", engines[k]))
+                return 1;
+        }
+#ifndef _WIN32
+        signal(SIGPIPE, SIG_IGN); // упавший движок не должен завершать матч
+#endif
+        auto start = chrono::steady_clock::now();
+        openings = load_openings();
+#ifdef CHECKERS_TRACE
+        Trace::start(false); // пишет только партия Trace.Game
+#endif
+        if (openings.empty())
+        {
+            cout << "Match: no openings\n";
+            return 1;
+        }
+        cout << "Match " << engines[0].name << " vs " << engines[1].name << ": " << openings.size()
+             << " openings, SPRT elo0 " << sprt.elo0 << " elo1 " << sprt.elo1 << " bounds [" << sprt.lower()
+             << ", " << sprt.upper() << "]\n";
+
+        unique_ptr<Pdn_writer> writer;
+        if (!pdn_file.empty())
+            writer = make_unique<Pdn_writer>(project_path + pdn_file);
+        {
+            ThreadPool pool(threads);
+            mcts_threads = ThreadPool::threads_per_task(pool.size());
+            const size_t max_pairs = (max_games + 1) / 2;
+            for (size_t pair = 0; pair < max_pairs; ++pair)
+            {
+                {
+                    // Новая пара начинается, только пока тест не решён
+                    unique_lock<mutex> lock(mtx);
+                    done_cv.wait(lock, [this, &pool]() { return in_flight < pool.size() || is_stop; });
+                    if (is_stop)
+                        break;
+                    ++in_flight;
+                }
+                pool.submit([this, pair, &writer]() {
+                    play_pair(pair, writer.get());
+                    {
+                        lock_guard<mutex> lock(mtx);
+                        --in_flight;
+                    }
+                    done_cv.notify_one();
+                });
+            }
+            pool.wait();
+        }
+#ifdef CHECKERS_TRACE
+        Trace::write_logged(project_path + string((*config)("Trace", "File")), project_path + "log.txt");
+#endif
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        string summary = "Match " + engines[0].name + " vs " + engines[1].name + ": " + status();
+        if (!error.empty())
+            summary += ", error: " + error;
+        else
+            summary += verdict.empty() ? ", no verdict" : ", " + verdict + " accepted";
+        for (auto &e : engines)
+        {
+            char buf[64];
+            snprintf(buf, sizeof(buf), " %.2f ms/move", e.moves ? e.total_ms / e.moves : 0.0);
+            summary += ", " + e.name + buf;
+        }
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << summary << ", " << int(sec * 1000) << " millisec\n";
+        log.close();
+        cout << summary << "\n";
+        return error.empty() ? 0 : 1;
+    }
+
+private:
+    // Сторона матча: настройки бота поверх общих и учёт времени на ход
+    struct match_engine
+    {
+        string name;
+        string command; // внешний движок, пустая строка - логика этой сборки
+        int level = 0;
+        double time_ms = 0;
+        unique_ptr<Config> config;
+        double total_ms = 0; // время всех ходов
+        size_t moves = 0;
+    };
+
+    // Начальная позиция пары партий
+    struct match_opening
+    {
+        vector<vector<POS_T>> mtx;
+        bool color = 0;
+        int plies = 0; // полуходов от начала партии
+    };
+
+    // Name, Level, TimeMS и Command - настройки стороны, остальные ключи заменяют ключи секции "Bot"
+    bool load_engine(const string &key, match_engine &engine)
+    {
+        json section = (*config)("Match", key);
+        engine.config = make_unique<Config>(*config);
+        for (auto &item : section.items())
+        {
+            if (item.key() == "Name")
+                engine.name = item.value().get<string>();
+            else if (item.key() == "Level")
+                engine.level = item.value();
+            else if (item.key() == "TimeMS")
+                engine.time_ms = item.value();
+            else if (item.key() == "Command")
+                engine.command = item.value().get<string>();
+            else
+                engine.config->set("Bot", item.key(), item.value());
+        }
+        if (engine.name.empty())
+            engine.name = key;
+#ifdef _WIN32
+        if (!engine.command.empty())
+        {
+            cout << "Match: external engines are not supported on Windows\n";
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    unique_ptr<Match_player> make_player(match_engine &engine, const unsigned player_seed) const
+    {
+#ifndef _WIN32
+        if (!engine.command.empty())
+            return make_unique<Process_player>(engine.command, engine.level, engine.time_ms);
+#endif
+        return make_unique<Logic_player>(engine.config.get(), engine.level, engine.time_ms, player_seed,
+                                         mcts_threads);
+    }
+
+    // Дебюты из OpeningsFile (строки FEN) или все начала длиной OpeningPlies полуходов,
+    // оценка которых на уровне OpeningLevel близка к равной. Порядок перемешивается зерном Seed
+    vector<match_opening> load_openings() const
+    {
+        vector<match_opening> res;
+        const string file = (*config)("Match", "OpeningsFile");
+        Logic logic(nullptr, config);
+        if (!file.empty())
+        {
+            ifstream fin(project_path + file);
+            string line;
+            while (getline(fin, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || line[0] == '#')
+                    continue;
+                match_opening op;
+                if (Notation::parse_fen(line.substr(0, line.find_first_of(" \t")), op.mtx, op.color))
+                    res.push_back(op);
+            }
+        }
+        else
+        {
+            const int plies = (*config)("Match", "OpeningPlies");
+            const double balance = (*config)("Match", "OpeningBalance");
+            logic.Max_depth = (*config)("Match", "OpeningLevel");
+            vector<match_opening> all;
+            set<string> seen;
+            add_openings(logic, {Board::start_mtx(), 0, 0}, plies, seen, all);
+            for (auto &op : all)
+            {
+                auto lines = logic.analyse(op.mtx, op.color, 1);
+                if (!lines.empty() && lines[0].score <= balance && lines[0].score >= 1 / balance)
+                    res.push_back(op);
+            }
+        }
+        shuffle(res.begin(), res.end(), default_random_engine(seed));
+        return res;
+    }
+
+    // Все позиции через plies полуходов от op без повторов (переставленные ходы дают одну позицию)
+    static void add_openings(Logic &logic, const match_opening &op, const int plies, set<string> &seen,
+                             vector<match_opening> &res)
+    {
+        if (op.plies == plies)
+        {
+            if (seen.insert(Notation::fen(op.mtx, op.color)).second)
+                res.push_back(op);
+            return;
+        }
+        for (auto &turn : Notation::legal_turns(logic, op.mtx, op.color))
+        {
+            match_opening next = {op.mtx, !op.color, op.plies + 1};
+            for (auto &step : turn)
+                next.mtx = logic.make_turn(next.mtx, step);
+            add_openings(logic, next, plies, seen, res);
+        }
+    }
+
+    // Две партии из одного дебюта: первый движок играет белыми, затем черными
+    void play_pair(const size_t pair, Pdn_writer *writer)
+    {
+        const match_opening &opening = openings[pair % openings.size()];
+        int scores[2]; // очки первого движка в полуочках
+        double total_ms[2] = {0, 0};
+        size_t moves[2] = {0, 0};
+        try
+        {
+            unique_ptr<Match_player> players[2];
+            for (int k = 0; k < 2; ++k)
+                players[k] = make_player(engines[k], unsigned(seed + pair));
+            for (int game = 0; game < 2; ++game)
+            {
+                const int white = game; // индекс движка белых
+                pdn_game pdn;
+                pdn.set_tag("Event", "Match " + engines[0].name + " vs " + engines[1].name);
+                pdn.set_tag("Round", to_string(pair * 2 + game + 1));
+                pdn.set_tag("White", engines[white].name);
+                pdn.set_tag("Black", engines[1 - white].name);
+                const int result = play_game(opening, players, white, int(pair * 2 + game + 1), total_ms, moves, pdn);
+                scores[game] = result == 0 ? 1 : ((result == 1) == (white == 0) ? 2 : 0);
+                if (writer)
+                    writer->write(pdn);
+            }
+        }
+        catch (const exception &e)
+        {
+            lock_guard<mutex> lock(mtx);
+            error = e.what();
+            is_stop = true;
+            return;
+        }
+
+        lock_guard<mutex> lock(mtx);
+        for (int k = 0; k < 2; ++k)
+        {
+            engines[k].total_ms += total_ms[k];
+            engines[k].moves += moves[k];
+        }
+        for (int s : scores)
+        {
+            wins += (s == 2);
+            draws += (s == 1);
+            losses += (s == 0);
+        }
+        const double llr = sprt.llr(wins, draws, losses);
+        if (verdict.empty() && llr >= sprt.upper())
+            verdict = "H1";
+        else if (verdict.empty() && llr <= sprt.lower())
+            verdict = "H0";
+        if (!verdict.empty())
+            is_stop = true;
+        cout << "Match: " << status() << "\n";
+    }
+
+    // Партия из дебюта opening, white - индекс движка белых, round - номер партии матча (с 1).
+    // Возвращает итог в кодах файла позиций (0 ничья, 1 победа белых, 2 победа черных) и заполняет
+    // ходы и теги pdn
+    int play_game(const match_opening &opening, unique_ptr<Match_player> players[2], const int white,
+                  const int round, double total_ms[2], size_t moves[2], pdn_game &pdn) const
+    {
+        const int max_turns = (*config)("Game", "MaxNumTurns");
+        const trace_plies traced{(*config)("Trace", "Game"), (*config)("Trace", "FromPly"), (*config)("Trace", "ToPly")};
+        const int adjudicate_material = (*config)("Match", "AdjudicateMaterial");
+        const int adjudicate_plies = (*config)("Match", "AdjudicatePlies");
+        const int draw_plies = (*config)("Match", "DrawPlies");
+
+        Logic logic(nullptr, config); // только генерация и проверка ходов
+        auto mtx = opening.mtx;
+        bool color = opening.color;
+        pdn.set_tag("FEN", Notation::fen(mtx, color));
+        for (int k = 0; k < 2; ++k)
+            players[k]->new_game();
+
+        int result = 0;
+        string termination = "move limit";
+        int lead_plies = 0;  // полуходов подряд с решающим перевесом одной стороны
+        int lead_side = 0;   // 1 - перевес белых, 2 - черных
+        int quiet_plies = 0; // полуходов подряд без взятий и ходов простых шашек
+        for (int ply = opening.plies; ply < max_turns; ++ply)
+        {
+            const int engine = color ? 1 - white : white;
+            players[engine]->set_trace(traced.contains(round, ply));
+            auto begin = chrono::steady_clock::now();
+            const string name = players[engine]->best_move(mtx, color);
+            total_ms[engine] += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+            ++moves[engine];
+
+            auto turn = name.empty() ? vector<move_pos>() : Notation::parse_turn(logic, mtx, color, name);
+            if (turn.empty())
+            {
+                // Нет ходов - поражение; ход не по правилам или упавший движок - тоже
+                logic.find_turns(color, mtx);
+                termination = logic.turns.empty() ? "normal" : "illegal move " + name;
+                result = color ? 1 : 2;
+                break;
+            }
+            const bool is_quiet = turn[0].xb == -1 && mtx[turn[0].x][turn[0].y] > 2;
+            for (auto &step : turn)
+                mtx = logic.make_turn(mtx, step);
+            pdn.moves.push_back(Notation::turn_name(turn));
+            color = !color;
+
+            quiet_plies = is_quiet ? quiet_plies + 1 : 0;
+            if (draw_plies > 0 && quiet_plies >= draw_plies)
+            {
+                termination = "adjudication";
+                break;
+            }
+            const int diff = material(mtx, 0) - material(mtx, 1);
+            const int side = diff >= adjudicate_material ? 1 : (-diff >= adjudicate_material ? 2 : 0);
+            lead_plies = (side != 0 && side == lead_side) ? lead_plies + 1 : 1;
+            lead_side = side;
+            if (adjudicate_material > 0 && side != 0 && lead_plies >= adjudicate_plies)
+            {
+                termination = "adjudication";
+                result = side;
+                break;
+            }
+        }
+        pdn.result = result == 0 ? "1-1" : (result == 1 ? "2-0" : "0-2");
+        pdn.set_tag("Result", pdn.result);
+        pdn.set_tag("Termination", termination);
+        return result;
+    }
+
+    // Материал стороны: дамка стоит King_material простых шашек
+    static int material(const vector<vector<POS_T>> &mtx, const bool color)
+    {
+        int res = 0;
+        for (auto &row : mtx)
+        {
+            for (POS_T p : row)
+            {
+                if (p != 0 && (p % 2 == 0) == color)
+                    res += p > 2 ? King_material : 1;
+            }
+        }
+        return res;
+    }
+
+    // Счёт, Elo первого движка с 95% интервалом и LLR (вызывается под замком)
+    string status() const
+    {
+        const size_t games = wins + draws + losses;
+        const double s = sprt_test::score(wins, draws, losses);
+        const double margin = games ? 1.96 * sqrt(sprt_test::variance(wins, draws, losses) / games) : 0;
+        const double elo = sprt_test::score_elo(s);
+        const double error_bar = (sprt_test::score_elo(s + margin) - sprt_test::score_elo(s - margin)) / 2;
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%zu games, +%zu =%zu -%zu, Elo %.1f +- %.1f, LLR %.2f [%.2f, %.2f]", games,
+                 wins, draws, losses, elo, error_bar, sprt.llr(wins, draws, losses), sprt.lower(), sprt.upper());
+        return buf;
+    }
+
+private:
+    static const int King_material = 3;
+    Config *config; // указатель на Config
+    match_engine engines[2];
+    vector<match_opening> openings;
+    sprt_test sprt;
+    unsigned seed = 1;
+    size_t mcts_threads = 1; // потоков на дерево MCTS движков этого процесса (доля ядер на поток пула)
+    mutex mtx;
+    condition_variable done_cv;
+    size_t in_flight = 0; // пар в работе
+    bool is_stop = false; // новые пары не начинаются
+    size_t wins = 0, draws = 0, losses = 0; // итоги первого движка
+    string verdict; // "H0", "H1" или пусто, пока тест не решён
+    string error;
+};
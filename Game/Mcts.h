@@ -0,0 +1,442 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../Models/Analysis.h"
+#include "../Models/Move.h"
+
+// Узел дерева MCTS. Счётчики атомарные: потоки спускаются по дереву и обновляют его без замков.
+// Дети и ход узла записываются до публикации state = Expanded и дальше не меняются
+struct mcts_node
+{
+    std::atomic<uint32_t> visits{0};
+    std::atomic<uint32_t> virtual_loss{0}; // потоков, идущих через узел сейчас: для выбора - проигрыши
+    std::atomic<int64_t> value{0};         // сумма результатов стороны, сделавшей ход в узел, в Value_scale
+    std::atomic<uint8_t> state{0};         // Unexpanded, Expanding, Expanded, Leaf
+    uint32_t first_child = 0;
+    uint32_t child_count = 0;
+    uint32_t move_begin = 0; // полный ход в узел: шаги moves[move_begin, move_begin + move_len)
+    uint32_t move_len = 0;
+};
+
+// Итог поиска MCTS
+struct mcts_info
+{
+    size_t playouts = 0;
+    double ms = 0;
+    size_t tree_nodes = 0;  // узлов в пуле после поиска
+    bool reused = false;    // корень найден в дереве прошлого хода
+};
+
+// Поиск Монте-Карло по дереву (бот с Bot.Engine "MCTS", секция "Mcts"). Потоки делят одно дерево
+// (tree parallelization): узлы берутся из заранее выделенного пула атомарным счётчиком, выбор ребёнка -
+// UCT, идущий через узел поток временно считается его проигрышем (virtual loss), чтобы остальные
+// расходились по другим веткам. Раскрытый лист доигрывается случайными ходами по правилам (взятие
+// обязательно, серия ударов до конца) не дальше RolloutPlies полуходов, затем позиция оценивается
+// функцией оценки бота: отношение материала r превращается в долю выигрыша r / (1 + r).
+// Дерево живёт между ходами: новый корень ищется среди детей и внуков прошлого.
+// L - логика варианта, у каждого потока своя (генерация ходов меняет её состояние)
+template <class L> class Mcts
+{
+public:
+    // make_logic создаёт логику потока; pool_mb - размер пула узлов
+    Mcts(std::function<std::unique_ptr<L>()> make_logic, const size_t pool_mb, const size_t threads,
+         const int rollout_plies, const double exploration, const bool keep_tree)
+        : make_logic(std::move(make_logic)), rollout_plies(rollout_plies), exploration(exploration),
+          keep_tree(keep_tree)
+    {
+        capacity = std::max<size_t>(pool_mb * 1024 * 1024 / (sizeof(mcts_node) + 2 * sizeof(move_pos)), 16);
+        capacity = std::min<size_t>(capacity, UINT32_MAX / 2);
+        thread_count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Дерево сбрасывается (новая партия)
+    void clear()
+    {
+        has_tree = false;
+    }
+
+    // Поиск из позиции mtx с ходом color. stop(playouts) вызывается в первом потоке, true - хватит;
+    // report(round, lines) - после 1024 * 2^round доигровок. Возвращает multi_pv самых посещаемых
+    // ходов корня с оценкой (отношение материала, как у альфа-бета) и главным вариантом
+    std::vector<analysis_line> search(const std::vector<std::vector<POS_T>> &mtx, const bool color,
+                                      const size_t multi_pv, const std::function<bool(size_t)> &stop,
+                                      const std::function<void(int, const std::vector<analysis_line> &)> &report,
+                                      mcts_info &info)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        allocate();
+        while (helpers.size() < thread_count)
+        {
+            helpers.push_back(make_logic());
+            helpers.back()->set_seed(unsigned(helpers.size() * 7919 + seed++));
+        }
+        info.reused = keep_tree && has_tree && find_root(*helpers[0], mtx, color);
+        if (!info.reused)
+            reset(mtx, color);
+        done = false;
+        playouts = 0;
+
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < thread_count; ++t)
+            threads.emplace_back([this, t]() { work(*helpers[t], t, nullptr, nullptr, 0); });
+        work(*helpers[0], 0, &stop, &report, multi_pv);
+        for (auto &th : threads)
+            th.join();
+
+        info.playouts = playouts.load();
+        info.tree_nodes = next_node.load();
+        info.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return lines(multi_pv);
+    }
+
+private:
+    enum : uint8_t
+    {
+        Unexpanded,
+        Expanding,
+        Expanded,
+        Leaf // пул кончился: узел остаётся листом
+    };
+
+    void allocate()
+    {
+        if (nodes)
+            return;
+        nodes.reset(new mcts_node[capacity]);
+        moves.assign(capacity * 2, move_pos(-1, -1, -1, -1));
+    }
+
+    void reset(const std::vector<std::vector<POS_T>> &mtx, const bool color)
+    {
+        next_node = 1;
+        next_move = 0;
+        init(0, 0, 0);
+        root = 0;
+        root_mtx = mtx;
+        root_color = color;
+        has_tree = true;
+    }
+
+    void init(const uint32_t index, const uint32_t move_begin, const uint32_t move_len)
+    {
+        mcts_node &node = nodes[index];
+        node.visits.store(0, std::memory_order_relaxed);
+        node.virtual_loss.store(0, std::memory_order_relaxed);
+        node.value.store(0, std::memory_order_relaxed);
+        node.state.store(Unexpanded, std::memory_order_relaxed);
+        node.first_child = node.child_count = 0;
+        node.move_begin = move_begin;
+        node.move_len = move_len;
+    }
+
+    // Новый корень - ребёнок или внук прошлого с той же позицией; пул, заполненный больше чем
+    // наполовину, лучше начать заново
+    bool find_root(L &logic, const std::vector<std::vector<POS_T>> &mtx, const bool color)
+    {
+        if (next_node.load() > capacity / 2)
+            return false;
+        const int plies = (color == root_color) ? 2 : 1;
+        std::vector<std::vector<POS_T>> board;
+        std::function<bool(uint32_t, const std::vector<std::vector<POS_T>> &, int)> find =
+            [&](const uint32_t index, const std::vector<std::vector<POS_T>> &from, const int left) {
+                const mcts_node &node = nodes[index];
+                if (node.state.load() != Expanded)
+                    return false;
+                for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c)
+                {
+                    board = from;
+                    apply(logic, board, nodes[c]);
+                    if (left > 1 ? find(c, std::vector<std::vector<POS_T>>(board), left - 1) : board == mtx)
+                    {
+                        if (left == 1)
+                            root = c;
+                        return true;
+                    }
+                }
+                return false;
+            };
+        if (!find(root, root_mtx, plies))
+            return false;
+        root_mtx = mtx;
+        root_color = color;
+        return true;
+    }
+
+    void work(L &logic, const size_t t, const std::function<bool(size_t)> *stop,
+              const std::function<void(int, const std::vector<analysis_line> &)> *report, const size_t multi_pv)
+    {
+        std::mt19937 rand_eng(unsigned(t * 104729 + seed));
+        std::vector<std::vector<POS_T>> mtx;
+        std::vector<uint32_t> path;
+        std::vector<std::vector<move_pos>> chains; // ходы раскрываемого узла
+        size_t own = 0;
+        int round = 0;
+        while (!done.load(std::memory_order_relaxed))
+        {
+            playout(logic, rand_eng, mtx, path, chains);
+            const size_t total = playouts.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (!stop || ++own % Check_playouts != 0)
+                continue;
+            if (*report && total >= (Report_playouts << round))
+            {
+                (*report)(round, lines(multi_pv));
+                ++round;
+            }
+            if ((*stop)(total))
+                done = true;
+        }
+    }
+
+    // Одна доигровка: спуск по UCT, раскрытие листа, случайная партия, обратный проход
+    void playout(L &logic, std::mt19937 &rand_eng, std::vector<std::vector<POS_T>> &mtx, std::vector<uint32_t> &path,
+                 std::vector<std::vector<move_pos>> &chains)
+    {
+        mtx = root_mtx;
+        bool color = root_color;
+        uint32_t index = root;
+        path.assign(1, index);
+        nodes[index].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+        double result; // для ходящей в последнем узле пути стороны: 1 - выигрыш
+        while (true)
+        {
+            mcts_node &node = nodes[index];
+            uint8_t state = node.state.load(std::memory_order_acquire);
+            if (state == Unexpanded && (index == root || node.visits.load(std::memory_order_relaxed) > 0) &&
+                node.state.compare_exchange_strong(state, Expanding, std::memory_order_acquire))
+                state = expand(logic, node, mtx, color, chains);
+            if (state != Expanded)
+            {
+                result = rollout(logic, rand_eng, mtx, color);
+                break;
+            }
+            if (node.child_count == 0)
+            {
+                result = 0; // ходов нет - проигрыш
+                break;
+            }
+            index = select(node);
+            apply(logic, mtx, nodes[index]);
+            color = !color;
+            path.push_back(index);
+            nodes[index].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+        }
+        for (size_t k = path.size(); k-- > 0;)
+        {
+            mcts_node &node = nodes[path[k]];
+            node.value.fetch_add(int64_t((1 - result) * Value_scale), std::memory_order_relaxed);
+            node.visits.fetch_add(1, std::memory_order_relaxed);
+            node.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+            result = 1 - result;
+        }
+    }
+
+    // UCT по ребёнку: доля выигрышей плюс бонус за малое число посещений; идущие через ребёнка потоки
+    // считаются проигрышами. Непосещённые дети идут первыми (их порядок перемешан генерацией ходов)
+    uint32_t select(const mcts_node &node) const
+    {
+        const double parent = node.visits.load(std::memory_order_relaxed) +
+                              node.virtual_loss.load(std::memory_order_relaxed) + 1;
+        const double log_parent = std::log(parent);
+        uint32_t best = node.first_child;
+        double best_u = -1;
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c)
+        {
+            const mcts_node &child = nodes[c];
+            const double n = child.visits.load(std::memory_order_relaxed) +
+                             child.virtual_loss.load(std::memory_order_relaxed);
+            if (n == 0)
+                return c;
+            const double q = child.value.load(std::memory_order_relaxed) / double(Value_scale) / n;
+            const double u = q + exploration * std::sqrt(log_parent / n);
+            if (u > best_u)
+            {
+                best_u = u;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    // Дети узла - все полные ходы позиции; возвращает новое состояние узла
+    uint8_t expand(L &logic, mcts_node &node, const std::vector<std::vector<POS_T>> &mtx, const bool color,
+                   std::vector<std::vector<move_pos>> &chains)
+    {
+        chains.clear();
+        std::vector<move_pos> chain;
+        logic.find_turns(color, mtx);
+        auto turns = logic.turns;
+        add_chains(logic, mtx, turns, logic.have_beats, chain, chains);
+        uint32_t steps = 0;
+        for (auto &c : chains)
+            steps += uint32_t(c.size());
+        const size_t first = next_node.fetch_add(chains.size(), std::memory_order_relaxed);
+        const size_t move_begin = next_move.fetch_add(steps, std::memory_order_relaxed);
+        if (first + chains.size() > capacity || move_begin + steps > moves.size())
+        {
+            node.state.store(Leaf, std::memory_order_release);
+            return Leaf;
+        }
+        uint32_t pos = uint32_t(move_begin);
+        for (size_t k = 0; k < chains.size(); ++k)
+        {
+            init(uint32_t(first + k), pos, uint32_t(chains[k].size()));
+            for (auto &step : chains[k])
+                moves[pos++] = step;
+        }
+        node.first_child = uint32_t(first);
+        node.child_count = uint32_t(chains.size());
+        node.state.store(Expanded, std::memory_order_release);
+        return Expanded;
+    }
+
+    void add_chains(L &logic, const std::vector<std::vector<POS_T>> &mtx, const std::vector<move_pos> &turns,
+                    const bool beats, std::vector<move_pos> &chain, std::vector<std::vector<move_pos>> &chains)
+    {
+        for (auto &turn : turns)
+        {
+            chain.push_back(turn);
+            if (beats)
+            {
+                auto next = logic.make_turn(mtx, turn);
+                logic.find_turns(turn.x2, turn.y2, next);
+                if (logic.have_beats)
+                {
+                    auto next_turns = logic.turns;
+                    add_chains(logic, next, next_turns, true, chain, chains);
+                    chain.pop_back();
+                    continue;
+                }
+            }
+            chains.push_back(chain);
+            chain.pop_back();
+        }
+    }
+
+    // Полный ход узла на доске mtx
+    void apply(L &logic, std::vector<std::vector<POS_T>> &mtx, const mcts_node &node) const
+    {
+        for (uint32_t k = node.move_begin; k < node.move_begin + node.move_len; ++k)
+            mtx = logic.make_turn(std::move(mtx), moves[k]);
+        logic.finish_series(mtx, moves[node.move_begin + node.move_len - 1]);
+    }
+
+    // Случайная партия не длиннее rollout_plies полуходов; результат для color: 1 - выигрыш, 0 - проигрыш,
+    // иначе доля выигрыша по оценке конечной позиции
+    double rollout(L &logic, std::mt19937 &rand_eng, std::vector<std::vector<POS_T>> &mtx, const bool color)
+    {
+        bool side = color;
+        for (int ply = 0; ply < rollout_plies; ++ply)
+        {
+            logic.find_turns(side, mtx);
+            if (logic.turns.empty())
+                return side == color ? 0 : 1;
+            move_pos turn = logic.turns[rand_eng() % logic.turns.size()];
+            while (true)
+            {
+                mtx = logic.make_turn(std::move(mtx), turn);
+                if (turn.xb == -1)
+                    break;
+                logic.find_turns(turn.x2, turn.y2, mtx);
+                if (!logic.have_beats)
+                {
+                    logic.finish_series(mtx, turn);
+                    break;
+                }
+                turn = logic.turns[rand_eng() % logic.turns.size()];
+            }
+            side = !side;
+        }
+        const double r = logic.evaluate(mtx, side);
+        const double p = r / (1 + r);
+        return side == color ? p : 1 - p;
+    }
+
+    // Самые посещаемые ходы корня; оценка - доля выигрыша q, переведённая в отношение q / (1 - q)
+    std::vector<analysis_line> lines(const size_t multi_pv) const
+    {
+        std::vector<analysis_line> res;
+        const mcts_node &node = nodes[root];
+        if (node.state.load(std::memory_order_acquire) != Expanded)
+            return res;
+        std::vector<uint32_t> order;
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c)
+            if (nodes[c].visits.load(std::memory_order_relaxed) > 0)
+                order.push_back(c);
+        std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) {
+            return nodes[a].visits.load(std::memory_order_relaxed) > nodes[b].visits.load(std::memory_order_relaxed);
+        });
+        for (size_t k = 0; k < order.size() && k < multi_pv; ++k)
+        {
+            analysis_line line;
+            line.turns = turn(order[k]);
+            const mcts_node &child = nodes[order[k]];
+            const double q = std::min(std::max(child.value.load(std::memory_order_relaxed) / double(Value_scale) /
+                                                   std::max<uint32_t>(child.visits.load(std::memory_order_relaxed), 1),
+                                               Min_share),
+                                      1 - Min_share);
+            line.score = q / (1 - q);
+            uint32_t index = order[k];
+            while (line.pv.size() < Max_pv && nodes[index].state.load(std::memory_order_acquire) == Expanded)
+            {
+                const mcts_node &cur = nodes[index];
+                uint32_t best = 0, best_visits = 0;
+                for (uint32_t c = cur.first_child; c < cur.first_child + cur.child_count; ++c)
+                {
+                    const uint32_t v = nodes[c].visits.load(std::memory_order_relaxed);
+                    if (v > best_visits)
+                    {
+                        best_visits = v;
+                        best = c;
+                    }
+                }
+                if (best_visits == 0)
+                    break;
+                line.pv.push_back(turn(best));
+                index = best;
+            }
+            res.push_back(line);
+        }
+        return res;
+    }
+
+    std::vector<move_pos> turn(const uint32_t index) const
+    {
+        const mcts_node &node = nodes[index];
+        return std::vector<move_pos>(moves.begin() + node.move_begin, moves.begin() + node.move_begin + node.move_len);
+    }
+
+    static const int64_t Value_scale = 1 << 16;     // результат доигровки в единицах счётчика value
+    static const size_t Check_playouts = 64;        // как часто первый поток проверяет лимиты
+    static const size_t Report_playouts = 1024;     // первый отчёт; дальше - при удвоении доигровок
+    static const size_t Max_pv = 16;
+    static constexpr double Min_share = 1e-6;       // доля выигрыша для оценки не ближе к 0 и 1
+
+    std::function<std::unique_ptr<L>()> make_logic;
+    int rollout_plies;
+    double exploration;
+    bool keep_tree;
+    size_t capacity = 0;      // узлов в пуле
+    size_t thread_count = 1;
+    std::vector<std::unique_ptr<L>> helpers; // логики потоков
+    unsigned seed = 0;
+
+    std::unique_ptr<mcts_node[]> nodes;
+    std::vector<move_pos> moves; // шаги ходов узлов
+    std::atomic<size_t> next_node{0};
+    std::atomic<size_t> next_move{0};
+    uint32_t root = 0;
+    std::vector<std::vector<POS_T>> root_mtx;
+    bool root_color = 0;
+    bool has_tree = false;
+    std::atomic<bool> done{false};
+    std::atomic<size_t> playouts{0};
+};
@@ -0,0 +1,265 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "../Models/Move.h"
+
+// Размеры сети: 4 типа фигур x 32 тёмных поля -> 32 нейрона -> 1 выход
+const int Network_inputs = 128;
+const int Network_hidden = 32;
+const char Network_file_magic[4] = {'C', 'K', 'N', 'N'};
+const uint16_t Network_file_version = 1;
+const int Network_activation_max = 127; // clipped ReLU в int8 [0, 127]
+
+// Веса сети до квантования (обучение "Checkers train"): скрытый слой clipped ReLU в [0, 1],
+// выход - логит с точки зрения белых
+struct network_float_weights
+{
+    float w1[Network_inputs][Network_hidden] = {};
+    float b1[Network_hidden] = {};
+    float w2[Network_hidden] = {};
+    float b2 = 0;
+};
+
+// Аккумулятор первого слоя, обновляется инкрементально при каждом ходе поиска
+struct alignas(32) network_accumulator
+{
+    int16_t v[Network_hidden];
+};
+
+// Небольшая квантованная сеть оценки позиции (int16 первый слой, int8 выходной)
+// Формат файла весов: "CKNN", uint16 версия, uint16 размер скрытого слоя,
+// int16 w1[128][32], int16 b1[32], int8 w2[32], int32 b2, float масштаб выхода
+class Network
+{
+public:
+    // Загружает веса из файла, false если файл отсутствует или повреждён
+    bool load(const std::string &path)
+    {
+        std::ifstream fin(path, std::ios_base::binary);
+        if (!fin)
+            return false;
+        char magic[4];
+        uint16_t header[2];
+        fin.read(magic, sizeof(magic));
+        fin.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!fin || memcmp(magic, Network_file_magic, sizeof(magic)) != 0 || header[0] != Network_file_version ||
+            header[1] != Network_hidden)
+            return false;
+        fin.read(reinterpret_cast<char *>(w1), sizeof(w1));
+        fin.read(reinterpret_cast<char *>(b1), sizeof(b1));
+        fin.read(reinterpret_cast<char *>(w2), sizeof(w2));
+        fin.read(reinterpret_cast<char *>(&b2), sizeof(b2));
+        fin.read(reinterpret_cast<char *>(&out_scale), sizeof(out_scale));
+        return bool(fin);
+    }
+
+    // Запись весов в формате load, false если файл не записан
+    bool save(const std::string &path) const
+    {
+        std::ofstream fout(path, std::ios_base::binary);
+        const uint16_t header[2] = {Network_file_version, uint16_t(Network_hidden)};
+        fout.write(Network_file_magic, sizeof(Network_file_magic));
+        fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+        fout.write(reinterpret_cast<const char *>(w1), sizeof(w1));
+        fout.write(reinterpret_cast<const char *>(b1), sizeof(b1));
+        fout.write(reinterpret_cast<const char *>(w2), sizeof(w2));
+        fout.write(reinterpret_cast<const char *>(&b2), sizeof(b2));
+        fout.write(reinterpret_cast<const char *>(&out_scale), sizeof(out_scale));
+        return bool(fout);
+    }
+
+    // Квантование обученных весов: активация 1.0 скрытого слоя становится 127, веса выхода
+    // растягиваются до предела int8 (не больше Max_output_scale, чтобы сохранить точность первого слоя)
+    void quantize(const network_float_weights &f)
+    {
+        float w2_max = 0;
+        for (int k = 0; k < Network_hidden; ++k)
+            w2_max = std::max(w2_max, std::fabs(f.w2[k]));
+        const float q2 = std::min(Max_output_scale, w2_max > 0 ? 127 / w2_max : Max_output_scale);
+        for (int i = 0; i < Network_inputs; ++i)
+        {
+            for (int k = 0; k < Network_hidden; ++k)
+                w1[i][k] = int16_t(std::lround(f.w1[i][k] * Network_activation_max));
+        }
+        for (int k = 0; k < Network_hidden; ++k)
+        {
+            b1[k] = int16_t(std::lround(f.b1[k] * Network_activation_max));
+            w2[k] = int8_t(std::lround(f.w2[k] * q2));
+        }
+        b2 = int32_t(std::lround(f.b2 * Network_activation_max * q2));
+        out_scale = 1 / (Network_activation_max * q2);
+    }
+
+    // Сеть, загруженная один раз на процесс для данного файла (Logic создаётся часто)
+    static std::shared_ptr<const Network> load_shared(const std::string &path)
+    {
+        static std::mutex mtx;
+        static std::map<std::string, std::shared_ptr<const Network>> cache;
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(path);
+        if (it != cache.end())
+            return it->second;
+        auto net = std::make_shared<Network>();
+        std::shared_ptr<const Network> res;
+        if (net->load(path))
+            res = net;
+        cache[path] = res;
+        return res;
+    }
+
+    // Номер входа для фигуры type (1..4) на клетке (i, j)
+    static int feature(const POS_T type, const POS_T i, const POS_T j)
+    {
+        return (type - 1) * 32 + i * 4 + j / 2;
+    }
+
+    // Полный пересчёт аккумулятора по доске (корень поиска)
+    void refresh(network_accumulator &acc, const std::vector<std::vector<POS_T>> &mtx) const
+    {
+        memcpy(acc.v, b1, sizeof(b1));
+        for (POS_T i = 0; i < 8; ++i)
+        {
+            for (POS_T j = 0; j < 8; ++j)
+            {
+                if (mtx[i][j])
+                    add_feature(acc, feature(mtx[i][j], i, j));
+            }
+        }
+    }
+
+    // Аккумулятор после хода turn на доске mtx (до хода): меняются только 2-3 входа
+    void update(const network_accumulator &from, network_accumulator &to, const std::vector<std::vector<POS_T>> &mtx,
+                const move_pos &turn) const
+    {
+        to = from;
+        POS_T type = mtx[turn.x][turn.y];
+        POS_T new_type = type;
+        if ((type == 1 && turn.x2 == 0) || (type == 2 && turn.x2 == 7))
+            new_type += 2;
+        sub_feature(to, feature(type, turn.x, turn.y));
+        add_feature(to, feature(new_type, turn.x2, turn.y2));
+        if (turn.xb != -1)
+            sub_feature(to, feature(mtx[turn.xb][turn.yb], turn.xb, turn.yb));
+    }
+
+    // Оценка (логит) с точки зрения белых
+    double evaluate(const network_accumulator &acc) const
+    {
+        return (dot(acc) + b2) * double(out_scale);
+    }
+
+private:
+    void add_feature(network_accumulator &acc, const int f) const
+    {
+#if defined(__AVX2__)
+        for (int k = 0; k < Network_hidden; k += 16)
+        {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc.v + k));
+            __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(w1[f] + k));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(acc.v + k), _mm256_add_epi16(a, w));
+        }
+#elif defined(__SSSE3__)
+        for (int k = 0; k < Network_hidden; k += 8)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(acc.v + k));
+            __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(w1[f] + k));
+            _mm_store_si128(reinterpret_cast<__m128i *>(acc.v + k), _mm_add_epi16(a, w));
+        }
+#else
+        for (int k = 0; k < Network_hidden; ++k)
+            acc.v[k] += w1[f][k];
+#endif
+    }
+
+    void sub_feature(network_accumulator &acc, const int f) const
+    {
+#if defined(__AVX2__)
+        for (int k = 0; k < Network_hidden; k += 16)
+        {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc.v + k));
+            __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(w1[f] + k));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(acc.v + k), _mm256_sub_epi16(a, w));
+        }
+#elif defined(__SSSE3__)
+        for (int k = 0; k < Network_hidden; k += 8)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(acc.v + k));
+            __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(w1[f] + k));
+            _mm_store_si128(reinterpret_cast<__m128i *>(acc.v + k), _mm_sub_epi16(a, w));
+        }
+#else
+        for (int k = 0; k < Network_hidden; ++k)
+            acc.v[k] -= w1[f][k];
+#endif
+    }
+
+    // Скалярное произведение clipped ReLU(acc) на веса выходного слоя
+    int32_t dot(const network_accumulator &acc) const
+    {
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i top = _mm256_set1_epi16(Network_activation_max);
+        __m256i a0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc.v));
+        __m256i a1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc.v + 16));
+        a0 = _mm256_max_epi16(_mm256_min_epi16(a0, top), zero);
+        a1 = _mm256_max_epi16(_mm256_min_epi16(a1, top), zero);
+        // packus перемешивает 128-битные половины, возвращаем порядок нейронов
+        __m256i act = _mm256_permute4x64_epi64(_mm256_packus_epi16(a0, a1), 0xD8);
+        __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(w2));
+        __m256i sum = _mm256_madd_epi16(_mm256_maddubs_epi16(act, w), _mm256_set1_epi16(1));
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+#elif defined(__SSSE3__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i top = _mm_set1_epi16(Network_activation_max);
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sum = zero;
+        for (int k = 0; k < Network_hidden; k += 16)
+        {
+            __m128i a0 = _mm_load_si128(reinterpret_cast<const __m128i *>(acc.v + k));
+            __m128i a1 = _mm_load_si128(reinterpret_cast<const __m128i *>(acc.v + k + 8));
+            a0 = _mm_max_epi16(_mm_min_epi16(a0, top), zero);
+            a1 = _mm_max_epi16(_mm_min_epi16(a1, top), zero);
+            __m128i act = _mm_packus_epi16(a0, a1);
+            __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(w2 + k));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(act, w), ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+#else
+        int32_t sum = 0;
+        for (int k = 0; k < Network_hidden; ++k)
+        {
+            int32_t a = acc.v[k] < 0 ? 0 : (acc.v[k] > Network_activation_max ? Network_activation_max : acc.v[k]);
+            sum += a * w2[k];
+        }
+        return sum;
+#endif
+    }
+
+private:
+    static constexpr float Max_output_scale = 64;
+
+    alignas(32) int16_t w1[Network_inputs][Network_hidden] = {};
+    alignas(32) int16_t b1[Network_hidden] = {};
+    alignas(32) int8_t w2[Network_hidden] = {};
+    int32_t b2 = 0;
+    float out_scale = 1;
+};
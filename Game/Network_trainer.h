@@ -0,0 +1,325 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <memory>
+#include <random>
+
+#include "../Models/Position_record.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Network.h"
+#include "Position_file.h"
+#include "ThreadPool.h"
+
+// Обучение сети оценки (режим "Checkers train") по размеченным позициям файла самоигры или разбора
+// партий. Цель - доля выигрыша белых: итог партии, смешанный с оценкой поиска r / (1 + r) в доле
+// ResultWeight. Сеть учится в float (Adam по перемешанным пачкам, градиент пачки считается кусками
+// на пуле потоков), каждая позиция берётся ещё и отражённой: доска повёрнута на 180 градусов, цвета
+// фигур и цель обменяны. Последние ValidationPercent процентов файла - проверочные партии, в файл
+// весов квантуется эпоха с наименьшей ошибкой на них
+class Network_trainer
+{
+public:
+    Network_trainer(Config *config) : config(config)
+    {
+    }
+
+    // input - файл позиций, пустая строка - InputFile из секции "Train"
+    int run(string input = "")
+    {
+        if (input.empty())
+            input = string((*config)("Train", "InputFile"));
+        const size_t threads = (*config)("Train", "Threads");
+        const int epochs = (*config)("Train", "Epochs");
+        const size_t batch_size = max(1, int((*config)("Train", "BatchSize")));
+        const int validation_percent = (*config)("Train", "ValidationPercent");
+        learning_rate = (*config)("Train", "LearningRate");
+        result_weight = (*config)("Train", "ResultWeight");
+        min_ply = (*config)("Train", "MinPly");
+
+        auto start = chrono::steady_clock::now();
+        unique_ptr<Position_map> file;
+        try
+        {
+            file = make_unique<Position_map>(project_path + input);
+        }
+        catch (const exception &e)
+        {
+            cout << "Train: " << e.what() << "\n";
+            return 1;
+        }
+        const Position_map &positions = *file;
+        const position_record *recs = positions.data();
+        const size_t split = positions.size() - positions.size() * size_t(max(0, validation_percent)) / 100;
+        vector<uint32_t> train, validation; // номер позиции * 2 + отражение
+        for (size_t k = 0; k < positions.size(); ++k)
+        {
+            if (!usable(recs[k]))
+                continue;
+            for (uint32_t mirror = 0; mirror < 2; ++mirror)
+                (k < split ? train : validation).push_back(uint32_t(k) * 2 + mirror);
+        }
+        if (train.empty())
+        {
+            cout << "Train: no labelled positions in " << input << "\n";
+            return 1;
+        }
+        cout << "Train: " << train.size() / 2 << " positions, " << validation.size() / 2 << " validation\n";
+
+        default_random_engine rand_eng((*config)("Train", "Seed").get<unsigned>());
+        network_float_weights w;
+        init(w, rand_eng);
+        adam_state adam;
+        ThreadPool pool(threads);
+        network_float_weights best = w;
+        double best_loss = numeric_limits<double>::max();
+        int best_epoch = 0;
+        for (int epoch = 1; epoch <= epochs; ++epoch)
+        {
+            shuffle(train.begin(), train.end(), rand_eng);
+            pass_result total;
+            for (size_t from = 0; from < train.size(); from += batch_size)
+            {
+                const size_t to = min(train.size(), from + batch_size);
+                pass_result r = pass(pool, recs, train.data() + from, to - from, w, true);
+                adam_step(w, r.grad, adam, double(r.count));
+                total.count += r.count;
+                total.error += r.error;
+            }
+            const pass_result check = pass(pool, recs, validation.data(), validation.size(), w, false);
+            const double loss = validation.empty() ? total.loss() : check.loss();
+            if (loss < best_loss)
+            {
+                best_loss = loss;
+                best = w;
+                best_epoch = epoch;
+            }
+            cout << "Epoch " << epoch << ": train loss " << total.loss() << ", validation loss " << check.loss()
+                 << "\n";
+        }
+
+        Network net;
+        net.quantize(best);
+        const double quantized_loss = network_loss(net, recs, validation.empty() ? train : validation);
+        const string output = (*config)("Train", "OutputFile");
+        if (!net.save(project_path + output))
+        {
+            cout << "Train: can't write " << output << "\n";
+            return 1;
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << "Train network: " << train.size() / 2 << " positions, " << epochs << " epochs, best epoch "
+            << best_epoch << ", loss " << best_loss << ", quantized " << quantized_loss << ", " << int(sec * 1000)
+            << " millisec\n";
+        cout << "Train: best epoch " << best_epoch << ", loss " << best_loss << ", quantized " << quantized_loss
+             << ", written to " << output << "\n";
+        return 0;
+    }
+
+private:
+    // Суммы по позициям одного прохода
+    struct pass_result
+    {
+        size_t count = 0;
+        double error = 0; // сумма квадратов ошибок доли выигрыша
+        network_float_weights grad; // сумма градиентов перекрёстной энтропии
+
+        double loss() const
+        {
+            return count ? error / count : 0;
+        }
+    };
+
+    // Моменты Adam для каждого веса
+    struct adam_state
+    {
+        network_float_weights m, v;
+        int steps = 0;
+    };
+
+    // Позиция с общими полями белых и черных испорчена: входов было бы больше 32
+    bool usable(const position_record &r) const
+    {
+        return r.result >= 0 && r.ply >= min_ply && r.white != 0 && r.black != 0 && (r.white & r.black) == 0;
+    }
+
+    // Входы сети для позиции (mirror - отражённая позиция), возвращает их количество
+    static int features(const position_record &r, const bool mirror, int *res)
+    {
+        const uint32_t masks[4] = {r.white & ~r.queens, r.black & ~r.queens, r.white & r.queens,
+                                   r.black & r.queens};
+        int n = 0;
+        for (int type = 0; type < 4; ++type)
+        {
+            // отражение: шашка белых на поле idx - шашка черных на поле 31 - idx
+            const int to_type = mirror ? (type ^ 1) : type;
+            for (int idx = 0; idx < 32; ++idx)
+            {
+                if (masks[type] >> idx & 1)
+                    res[n++] = to_type * 32 + (mirror ? 31 - idx : idx);
+            }
+        }
+        return n;
+    }
+
+    // Цель - доля выигрыша белых (у отражённой позиции - черных)
+    double target(const position_record &r, const bool mirror) const
+    {
+        const double result = (r.result == 0) ? 0.5 : (r.result == 1 ? 1 : 0);
+        double search = r.score >= INF ? 1 : (r.score <= 0 ? 0 : r.score / (1 + r.score));
+        if (r.color == 1)
+            search = 1 - search;
+        const double t = result_weight * result + (1 - result_weight) * search;
+        return mirror ? 1 - t : t;
+    }
+
+    // Ошибка и (если with_grad) градиент по позициям samples[0, n)
+    pass_result pass_range(const position_record *recs, const uint32_t *samples, const size_t n,
+                           const network_float_weights &w, const bool with_grad) const
+    {
+        pass_result res;
+        int active[32];
+        float pre[Network_hidden];
+        for (size_t s = 0; s < n; ++s)
+        {
+            const position_record &r = recs[samples[s] / 2];
+            const bool mirror = samples[s] % 2;
+            const int count = features(r, mirror, active);
+            for (int k = 0; k < Network_hidden; ++k)
+                pre[k] = w.b1[k];
+            for (int f = 0; f < count; ++f)
+            {
+                for (int k = 0; k < Network_hidden; ++k)
+                    pre[k] += w.w1[active[f]][k];
+            }
+            float h[Network_hidden];
+            double z = w.b2;
+            for (int k = 0; k < Network_hidden; ++k)
+            {
+                h[k] = min(1.0f, max(0.0f, pre[k]));
+                z += w.w2[k] * h[k];
+            }
+            const double p = 1 / (1 + exp(-z));
+            const double d = p - target(r, mirror);
+            ++res.count;
+            res.error += d * d;
+            if (!with_grad)
+                continue;
+            // производная перекрёстной энтропии по логиту - p - t
+            res.grad.b2 += float(d);
+            for (int k = 0; k < Network_hidden; ++k)
+            {
+                res.grad.w2[k] += float(d * h[k]);
+                if (pre[k] <= 0 || pre[k] >= 1)
+                    continue; // вне линейного участка градиент не проходит
+                const float g = float(d * w.w2[k]);
+                res.grad.b1[k] += g;
+                for (int f = 0; f < count; ++f)
+                    res.grad.w1[active[f]][k] += g;
+            }
+        }
+        return res;
+    }
+
+    // Пачка позиций: куски по потокам пула, суммы складываются по порядку кусков
+    pass_result pass(ThreadPool &pool, const position_record *recs, const uint32_t *samples, const size_t n,
+                     const network_float_weights &w, const bool with_grad) const
+    {
+        const size_t chunks = min(n, pool.size() * Chunks_per_thread);
+        vector<future<pass_result>> parts;
+        parts.reserve(chunks);
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            const size_t from = n * c / chunks, to = n * (c + 1) / chunks;
+            parts.push_back(pool.submit([this, recs, samples, &w, from, to, with_grad]() {
+                return pass_range(recs, samples + from, to - from, w, with_grad);
+            }));
+        }
+        pass_result total;
+        for (auto &part : parts)
+        {
+            pass_result r = part.get();
+            total.count += r.count;
+            total.error += r.error;
+            if (!with_grad)
+                continue;
+            float *sum = reinterpret_cast<float *>(&total.grad);
+            const float *part_sum = reinterpret_cast<const float *>(&r.grad);
+            for (size_t k = 0; k < sizeof(total.grad) / sizeof(float); ++k)
+                sum[k] += part_sum[k];
+        }
+        return total;
+    }
+
+    // Шаг Adam по среднему градиенту пачки; первый слой ограничен Max_weight, чтобы аккумулятор
+    // квантованной сети не переполнял int16
+    void adam_step(network_float_weights &w, network_float_weights &grad, adam_state &adam, const double count) const
+    {
+        ++adam.steps;
+        const double c1 = 1 - pow(Adam_beta1, adam.steps), c2 = 1 - pow(Adam_beta2, adam.steps);
+        float *pw = reinterpret_cast<float *>(&w);
+        float *pg = reinterpret_cast<float *>(&grad);
+        float *pm = reinterpret_cast<float *>(&adam.m);
+        float *pv = reinterpret_cast<float *>(&adam.v);
+        const size_t first_layer = (sizeof(w.w1) + sizeof(w.b1)) / sizeof(float);
+        for (size_t k = 0; k < sizeof(w) / sizeof(float); ++k)
+        {
+            const double g = pg[k] / count;
+            pm[k] = float(Adam_beta1 * pm[k] + (1 - Adam_beta1) * g);
+            pv[k] = float(Adam_beta2 * pv[k] + (1 - Adam_beta2) * g * g);
+            pw[k] -= float(learning_rate * (pm[k] / c1) / (sqrt(pv[k] / c2) + Adam_epsilon));
+            if (k < first_layer)
+                pw[k] = max(-Max_weight, min(Max_weight, pw[k]));
+        }
+    }
+
+    // Начальные веса: нейроны в середине линейного участка [0, 1], малый случайный разброс
+    static void init(network_float_weights &w, default_random_engine &rand_eng)
+    {
+        uniform_real_distribution<float> small(-Init_spread, Init_spread);
+        for (auto &row : w.w1)
+        {
+            for (float &x : row)
+                x = small(rand_eng);
+        }
+        for (int k = 0; k < Network_hidden; ++k)
+        {
+            w.b1[k] = 0.5f;
+            w.w2[k] = small(rand_eng);
+        }
+    }
+
+    // Ошибка квантованной сети тем же путём, что и в поиске: аккумулятор по доске и логит белых
+    double network_loss(const Network &net, const position_record *recs, const vector<uint32_t> &samples) const
+    {
+        double error = 0;
+        network_accumulator acc;
+        for (uint32_t s : samples)
+        {
+            if (s % 2)
+                continue; // отражённая позиция оценивается так же
+            const position_record &r = recs[s / 2];
+            net.refresh(acc, r.to_mtx());
+            const double d = 1 / (1 + exp(-net.evaluate(acc))) - target(r, false);
+            error += d * d;
+        }
+        return samples.empty() ? 0 : error / (samples.size() / 2);
+    }
+
+private:
+    static const size_t Chunks_per_thread = 4;
+    static constexpr double Adam_beta1 = 0.9, Adam_beta2 = 0.999, Adam_epsilon = 1e-8;
+    static constexpr float Max_weight = 2; // 24 фигуры * 2 * 127 далеко до предела int16
+    static constexpr float Init_spread = 0.1f;
+
+    Config *config; // указатель на Config
+    int min_ply = 0; // позиции раньше этого полухода не используются (случайный дебют)
+    double learning_rate = 0.001;
+    double result_weight = 0.5; // доля итога партии в цели, остальное - оценка поиска
+};
@@ -0,0 +1,243 @@
+#pragma once
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "../Models/Move.h"
+#include "Logic.h"
+
+// Текстовая запись полей, ходов и позиций (протокол движка, файлы партий).
+// Поле: буква столбца a-h слева направо и номер строки 1-8 снизу (со стороны белых),
+// тихий ход "c3-d4", серия ударов "c3:e5:g3"
+class Notation
+{
+public:
+    static string square_name(const POS_T x, const POS_T y)
+    {
+        return string(1, char('a' + y)) + char('8' - x);
+    }
+
+    // Поле по записи "c3", false если запись неверна
+    static bool parse_square(const string &s, POS_T &x, POS_T &y)
+    {
+        if (s.size() != 2 || s[0] < 'a' || s[0] > 'h' || s[1] < '1' || s[1] > '8')
+            return false;
+        y = POS_T(s[0] - 'a');
+        x = POS_T('8' - s[1]);
+        return true;
+    }
+
+    // Запись полного хода (цепочки ударов целиком)
+    static string turn_name(const vector<move_pos> &turn)
+    {
+        if (turn.empty())
+            return "";
+        string res = square_name(turn[0].x, turn[0].y);
+        for (auto &step : turn)
+            res += (step.xb == -1 ? "-" : ":") + square_name(step.x2, step.y2);
+        return res;
+    }
+
+    // Все полные ходы color на доске mtx, каждая серия ударов - до конца (L - логика варианта)
+    template <class L>
+    static vector<vector<move_pos>> legal_turns(L &logic, const vector<vector<POS_T>> &mtx, const bool color)
+    {
+        vector<vector<move_pos>> res;
+        vector<move_pos> chain;
+        logic.find_turns(color, mtx);
+        auto turns = logic.turns; // find_turns внутри add_turns меняет logic.turns
+        add_turns(logic, mtx, turns, logic.have_beats, chain, res);
+        return res;
+    }
+
+    // Разбор записи хода: совпадение с одним из допустимых ходов. Для серии ударов хватает
+    // начального и конечного полей, если так ход определён однозначно. Пустой вектор - ошибка
+    static vector<move_pos> parse_turn(Logic &logic, const vector<vector<POS_T>> &mtx, const bool color,
+                                       const string &s)
+    {
+        auto turns = legal_turns(logic, mtx, color);
+        for (auto &turn : turns)
+        {
+            if (turn_name(turn) == s)
+                return turn;
+        }
+        vector<move_pos> found;
+        for (auto &turn : turns)
+        {
+            string name = turn_name(turn);
+            if (name.size() >= 5 && s.size() == 5 && s[2] == name[2] && name.compare(0, 2, s, 0, 2) == 0 &&
+                name.compare(name.size() - 2, 2, s, 3, 2) == 0)
+            {
+                if (!found.empty())
+                    return {}; // неоднозначно
+                found = turn;
+            }
+        }
+        return found;
+    }
+
+    // Позиция строкой из 32 символов по тёмным полям (index = i * 4 + j / 2, с восьмой строки):
+    // '.' - пусто, 'w'/'b' - белая/черная шашка, 'W'/'B' - белая/черная дамка
+    static string board_string(const vector<vector<POS_T>> &mtx)
+    {
+        string res;
+        for (POS_T i = 0; i < 8; ++i)
+            for (POS_T j = (i + 1) % 2; j < 8; j += 2)
+                res += Piece_chars[mtx[i][j]];
+        return res;
+    }
+
+    // Доска по строке board_string, false если строка неверна
+    static bool parse_board(const string &s, vector<vector<POS_T>> &mtx)
+    {
+        if (s.size() != 32)
+            return false;
+        vector<vector<POS_T>> res(8, vector<POS_T>(8, 0));
+        for (POS_T i = 0; i < 8; ++i)
+        {
+            for (POS_T j = (i + 1) % 2; j < 8; j += 2)
+            {
+                auto pos = string(Piece_chars).find(s[i * 4 + j / 2]);
+                if (pos == string::npos)
+                    return false;
+                res[i][j] = POS_T(pos);
+            }
+        }
+        mtx = res;
+        return true;
+    }
+
+    // Позиция в записи FEN из PDN: сторона хода и списки фигур по цветам, дамки с префиксом K,
+    // например "W:Wc3,e3,Kd4:Bb6,f6". Белые - 'W', черные - 'B'
+    static string fen(const vector<vector<POS_T>> &mtx, const bool color)
+    {
+        string res = color ? "B" : "W";
+        for (POS_T side = 0; side < 2; ++side)
+        {
+            res += side ? ":B" : ":W";
+            bool first = true;
+            for (POS_T i = 7; i >= 0; --i)
+            {
+                for (POS_T j = i % 2 ? 0 : 1; j < 8; j += 2)
+                {
+                    if (!mtx[i][j] || mtx[i][j] % 2 == side)
+                        continue;
+                    if (!first)
+                        res += ",";
+                    first = false;
+                    res += (mtx[i][j] > 2 ? "K" : "") + square_name(i, j);
+                }
+            }
+        }
+        return res;
+    }
+
+    // Разбор FEN, false если запись неверна (фигура на светлом поле, неизвестный цвет и т.п.)
+    static bool parse_fen(const string &s, vector<vector<POS_T>> &mtx, bool &color)
+    {
+        vector<vector<POS_T>> res(8, vector<POS_T>(8, 0));
+        size_t pos = 0;
+        if (s.empty() || (s[0] != 'W' && s[0] != 'B'))
+            return false;
+        const bool side_to_move = (s[0] == 'B');
+        pos = 1;
+        while (pos < s.size())
+        {
+            if (s[pos] != ':' || pos + 1 >= s.size() || (s[pos + 1] != 'W' && s[pos + 1] != 'B'))
+                return false;
+            const POS_T side = (s[pos + 1] == 'B');
+            pos += 2;
+            while (pos < s.size() && s[pos] != ':')
+            {
+                size_t end = s.find_first_of(",:", pos);
+                if (end == string::npos)
+                    end = s.size();
+                string piece = s.substr(pos, end - pos);
+                const bool king = (!piece.empty() && piece[0] == 'K');
+                POS_T x, y;
+                if (!parse_square(piece.substr(king), x, y) || (x + y) % 2 == 0 || res[x][y])
+                    return false;
+                res[x][y] = POS_T(1 + side + 2 * king);
+                pos = (end < s.size() && s[end] == ',') ? end + 1 : end;
+            }
+        }
+        mtx = res;
+        color = side_to_move;
+        return true;
+    }
+
+    // Позиция команды position протоколов движка: startpos | board <32 символа> <w|b> | fen <FEN>,
+    // затем [moves ...]. Возвращает "" или текст ошибки, при ошибке mtx и color не меняются
+    static string parse_position(Logic &logic, istream &cmd, vector<vector<POS_T>> &mtx, bool &color)
+    {
+        string word;
+        cmd >> word;
+        vector<vector<POS_T>> new_mtx;
+        bool new_color = 0;
+        if (word == "startpos")
+        {
+            new_mtx = Logic::start_mtx();
+        }
+        else if (word == "board")
+        {
+            string s, side;
+            cmd >> s >> side;
+            if (!parse_board(s, new_mtx) || (side != "w" && side != "b"))
+                return "bad position";
+            new_color = (side == "b");
+        }
+        else if (word == "fen")
+        {
+            string s;
+            cmd >> s;
+            if (!parse_fen(s, new_mtx, new_color))
+                return "bad position";
+        }
+        else
+        {
+            return "bad position";
+        }
+        if (cmd >> word && word == "moves")
+        {
+            while (cmd >> word)
+            {
+                auto turn = parse_turn(logic, new_mtx, new_color, word);
+                if (turn.empty())
+                    return "illegal move " + word;
+                for (auto &step : turn)
+                    new_mtx = logic.make_turn(new_mtx, step);
+                logic.finish_series(new_mtx, turn.back());
+                new_color = !new_color;
+            }
+        }
+        mtx = new_mtx;
+        color = new_color;
+        return "";
+    }
+
+private:
+    template <class L>
+    static void add_turns(L &logic, const vector<vector<POS_T>> &mtx, const vector<move_pos> &turns,
+                          const bool beats, vector<move_pos> &chain, vector<vector<move_pos>> &res)
+    {
+        for (auto &turn : turns)
+        {
+            chain.push_back(turn);
+            auto next = logic.make_turn(mtx, turn);
+            if (beats)
+                logic.find_turns(turn.x2, turn.y2, next);
+            if (beats && logic.have_beats)
+            {
+                auto next_turns = logic.turns;
+                add_turns(logic, next, next_turns, true, chain, res);
+            }
+            else
+            {
+                res.push_back(chain);
+            }
+            chain.pop_back();
+        }
+    }
+
+    static constexpr const char *Piece_chars = ".wbWB"; // символы по типу фигуры
+};
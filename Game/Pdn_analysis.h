@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "../Models/Pdn_game.h"
+#include "../Models/Position_record.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "Pdn_file.h"
+#include "Position_file.h"
+#include "ThreadPool.h"
+
+// Пакетный разбор архива PDN (режим "Checkers analyse"): каждая партия проверяется генератором
+// ходов, все её позиции оцениваются поиском и пишутся в файл позиций. Партии читаются потоком
+// и разбираются параллельно, в памяти не больше нескольких партий на поток
+class Pdn_analysis
+{
+public:
+    Pdn_analysis(Config *config) : config(config)
+    {
+    }
+
+    // input - файл PDN, пустая строка - InputFile из секции "Analysis"
+    int run(string input = "")
+    {
+        if (input.empty())
+            input = project_path + string((*config)("Analysis", "InputFile"));
+        const size_t threads = (*config)("Analysis", "Threads");
+        const string output = (*config)("Analysis", "OutputFile");
+
+        auto start = chrono::steady_clock::now();
+        unique_ptr<Pdn_reader> reader;
+        try
+        {
+            reader = make_unique<Pdn_reader>(input);
+        }
+        catch (const exception &)
+        {
+            cout << "Can't open PDN file " << input << "\n";
+            return 1;
+        }
+        unique_ptr<Position_writer> writer;
+        try
+        {
+            writer = make_unique<Position_writer>(project_path + output);
+        }
+        catch (const exception &)
+        {
+            cout << "Can't write positions file " << output << "\n";
+            return 1;
+        }
+        ofstream log(project_path + "log.txt", ios_base::app);
+        size_t games = 0;
+        {
+            ThreadPool pool(threads);
+            mcts_threads = ThreadPool::threads_per_task(pool.size());
+            const size_t max_in_flight = pool.size() * In_flight_per_thread;
+            pdn_game game;
+            while (reader->next(game))
+            {
+                {
+                    // Читаем не быстрее, чем разбираем: архив не копится в памяти
+                    unique_lock<mutex> lock(mtx);
+                    done_cv.wait(lock, [this, max_in_flight]() { return in_flight < max_in_flight; });
+                    ++in_flight;
+                }
+                const size_t index = games++;
+                pool.submit([this, &writer, &log, index, game = move(game)]() {
+                    string error;
+                    auto records = analyse_game(game, error);
+                    writer->write(records);
+                    {
+                        lock_guard<mutex> lock(mtx);
+                        if (!error.empty())
+                        {
+                            ++invalid;
+                            log << "PDN game " << index + 1 << ": " << error << "\n";
+                        }
+                        --in_flight;
+                    }
+                    done_cv.notify_one();
+                });
+            }
+            pool.wait();
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        log << "PDN analysis: " << games << " games, " << invalid << " invalid, " << writer->count() << " positions, "
+            << int(sec * 1000) << " millisec, " << int(writer->count() / max(sec, 1e-9)) << " positions/sec\n";
+        log.close();
+        cout << "PDN analysis: " << games << " games, " << invalid << " invalid, " << writer->count()
+             << " positions\n";
+        return 0;
+    }
+
+    // Проверка ходов партии и оценка позиций перед каждым ходом. При недопустимом ходе
+    // возвращаются позиции до него, а error описывает ошибку
+    vector<position_record> analyse_game(const pdn_game &game, string &error)
+    {
+        auto logic = take_logic();
+        vector<position_record> records;
+        auto mtx = Board::start_mtx();
+        bool color = 0;
+        const string fen = game.tag("FEN");
+        if (!fen.empty() && !Notation::parse_fen(fen, mtx, color))
+        {
+            error = "bad FEN " + fen;
+            give_logic(move(logic));
+            return {};
+        }
+        for (size_t ply = 0; ply < game.moves.size(); ++ply)
+        {
+            auto turn = Notation::parse_turn(*logic, mtx, color, game.moves[ply]);
+            if (turn.empty())
+            {
+                error = "illegal move " + game.moves[ply] + " at ply " + to_string(ply + 1);
+                break;
+            }
+            logic->find_best_turns(mtx, color);
+            records.emplace_back(mtx, color, float(logic->last_score), uint16_t(ply));
+            for (auto &step : turn)
+                mtx = logic->make_turn(mtx, step);
+            color = !color;
+        }
+        for (auto &rec : records)
+            rec.result = int8_t(game.result_code());
+        give_logic(move(logic));
+        return records;
+    }
+
+private:
+    // Логика на время разбора одной партии: хеш-таблица переходит от партии к партии
+    unique_ptr<Logic> take_logic()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (!logics.empty())
+            {
+                auto logic = move(logics.back());
+                logics.pop_back();
+                return logic;
+            }
+        }
+        auto logic = make_unique<Logic>(nullptr, config);
+        logic->set_hash_size_mb((*config)("Analysis", "HashSizeMB"));
+        logic->set_mcts_threads(mcts_threads);
+        logic->Max_depth = (*config)("Analysis", "BotLevel");
+        return logic;
+    }
+
+    void give_logic(unique_ptr<Logic> logic)
+    {
+        lock_guard<mutex> lock(mtx);
+        logics.push_back(move(logic));
+    }
+
+private:
+    const size_t In_flight_per_thread = 4; // партий в очереди пула на один поток
+    Config *config; // указатель на Config
+    mutex mtx;
+    condition_variable done_cv;
+    size_t in_flight = 0; // прочитано, но ещё не разобрано
+    size_t invalid = 0; // партий с недопустимым ходом
+    vector<unique_ptr<Logic>> logics; // свободные логики потоков
+    size_t mcts_threads = 1; // потоков на дерево MCTS каждой логики (доля ядер на поток пула)
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "../Models/Pdn_game.h"
+
+// Дозапись партий в текстовый файл PDN, безопасна для нескольких потоков
+class Pdn_writer
+{
+public:
+    Pdn_writer(const std::string &path)
+    {
+        fout.open(path, std::ios_base::app);
+        if (!fout)
+            throw std::runtime_error("can't open PDN file " + path);
+    }
+
+    void write(const pdn_game &game)
+    {
+        std::string text;
+        for (auto &t : game.tags)
+        {
+            text += "[" + t.first + " \"";
+            for (char c : t.second)
+            {
+                if (c == '"' || c == '\\')
+                    text += '\\';
+                text += c;
+            }
+            text += "\"]\n";
+        }
+        text += "\n";
+        // Ходы парами с номерами, строки не длиннее Line_width
+        std::string line;
+        for (size_t k = 0; k < game.moves.size(); ++k)
+        {
+            std::string word = (k % 2 == 0 ? std::to_string(k / 2 + 1) + ". " : "") + game.moves[k];
+            add_word(text, line, word);
+        }
+        add_word(text, line, game.result);
+        text += line + "\n\n";
+
+        std::lock_guard<std::mutex> lock(mtx);
+        fout << text;
+        fout.flush();
+    }
+
+private:
+    void add_word(std::string &text, std::string &line, const std::string &word) const
+    {
+        if (!line.empty() && line.size() + 1 + word.size() > Line_width)
+        {
+            text += line + "\n";
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + word;
+    }
+
+    const size_t Line_width = 79;
+    std::ofstream fout;
+    std::mutex mtx;
+};
+
+// Потоковое чтение PDN: файл читается по строкам, в памяти только текущая партия.
+// Пропускаются комментарии {...}, варианты (...), строки после ';' и '%', номера ходов и NAG ($n)
+class Pdn_reader
+{
+public:
+    Pdn_reader(const std::string &path)
+    {
+        fin.open(path);
+        if (!fin)
+            throw std::runtime_error("can't open PDN file " + path);
+    }
+
+    // Возвращает следующую партию, false в конце файла
+    bool next(pdn_game &game)
+    {
+        std::string line;
+        while (ready.empty() && std::getline(fin, line))
+            parse_line(line);
+        if (ready.empty())
+        {
+            finish_game(); // последняя партия без результата
+            if (ready.empty())
+                return false;
+        }
+        game = std::move(ready.front());
+        ready.pop_front();
+        return true;
+    }
+
+private:
+    void parse_line(const std::string &line)
+    {
+        if (!line.empty() && line[0] == '%' && !depth)
+            return;
+        size_t i = 0;
+        while (i < line.size())
+        {
+            const char c = line[i];
+            if (depth) // внутри комментария или варианта
+            {
+                if (c == '{' || c == '(')
+                    ++depth;
+                else if (c == '}' || c == ')')
+                    --depth;
+                ++i;
+            }
+            else if (c == '{' || c == '(')
+            {
+                ++depth;
+                ++i;
+            }
+            else if (c == ';')
+            {
+                return;
+            }
+            else if (c == '[')
+            {
+                i = parse_tag(line, i + 1);
+            }
+            else if (isspace((unsigned char)c))
+            {
+                ++i;
+            }
+            else
+            {
+                size_t end = i;
+                while (end < line.size() && !isspace((unsigned char)line[end]) &&
+                       std::string("{}()[];").find(line[end]) == std::string::npos)
+                    ++end;
+                parse_word(line.substr(i, end - i));
+                i = end;
+            }
+        }
+    }
+
+    // Тег [Name "Value"], возвращает позицию после ']'
+    size_t parse_tag(const std::string &line, size_t i)
+    {
+        if (!current.moves.empty())
+            finish_game(); // новые теги после ходов - началась следующая партия
+        size_t name_end = i;
+        while (name_end < line.size() && !isspace((unsigned char)line[name_end]) && line[name_end] != '"' &&
+               line[name_end] != ']')
+            ++name_end;
+        std::string name = line.substr(i, name_end - i);
+        std::string value;
+        i = line.find('"', name_end);
+        if (i != std::string::npos)
+        {
+            for (++i; i < line.size() && line[i] != '"'; ++i)
+            {
+                if (line[i] == '\\' && i + 1 < line.size())
+                    ++i;
+                value += line[i];
+            }
+        }
+        i = line.find(']', i == std::string::npos ? name_end : i);
+        current.tags.emplace_back(name, value);
+        has_content = true;
+        return i == std::string::npos ? line.size() : i + 1;
+    }
+
+    void parse_word(std::string word)
+    {
+        if (word == "*" || word == "2-0" || word == "0-2" || word == "1-1" || word == "1-0" || word == "0-1" ||
+            word == "0-0" || word == "1/2-1/2")
+        {
+            current.result = word;
+            has_content = true;
+            finish_game();
+            return;
+        }
+        if (word[0] == '$')
+            return; // NAG
+        // Номер хода "12." или "12..." может быть слит с ходом: "12.c3-d4"
+        size_t k = 0;
+        while (k < word.size() && isdigit((unsigned char)word[k]))
+            ++k;
+        if (k < word.size() && word[k] == '.')
+        {
+            while (k < word.size() && word[k] == '.')
+                ++k;
+            word = word.substr(k);
+        }
+        while (!word.empty() && (word.back() == '!' || word.back() == '?' || word.back() == '+'))
+            word.pop_back();
+        if (word.empty())
+            return;
+        current.moves.push_back(word);
+        has_content = true;
+    }
+
+    void finish_game()
+    {
+        if (has_content)
+        {
+            if (current.result == "*" && !current.tag("Result").empty())
+                current.result = current.tag("Result");
+            ready.push_back(std::move(current));
+        }
+        current = pdn_game();
+        has_content = false;
+    }
+
+    std::ifstream fin;
+    std::deque<pdn_game> ready; // разобранные, но ещё не выданные партии
+    pdn_game current; // партия, которая сейчас разбирается
+    bool has_content = false;
+    int depth = 0; // вложенность комментариев и вариантов
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "../Models/Analysis.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Анализ списка позиций (режим "Checkers positions"): по строке FEN на позицию, после FEN через
+// пробел может идти произвольный идентификатор. Позиции считаются параллельно на пуле потоков,
+// результаты пишутся строками JSON в порядке входного файла
+class Position_analysis
+{
+public:
+    Position_analysis(Config *config) : config(config)
+    {
+    }
+
+    // input - файл позиций, пустая строка - InputFile из секции "Positions"
+    int run(string input = "")
+    {
+        if (input.empty())
+            input = project_path + string((*config)("Positions", "InputFile"));
+        const size_t threads = (*config)("Positions", "Threads");
+        const string output = (*config)("Positions", "OutputFile");
+
+        ifstream fin(input);
+        if (!fin)
+        {
+            cout << "Can't open positions file " << input << "\n";
+            return 1;
+        }
+        ofstream fout(project_path + output);
+        auto start = chrono::steady_clock::now();
+        size_t count = 0;
+#ifdef CHECKERS_TRACE
+        Trace::start(false); // пишет только позиция Trace.Position
+#endif
+        {
+            ThreadPool pool(threads);
+            mcts_threads = ThreadPool::threads_per_task(pool.size());
+            vector<future<string>> results;
+            string line;
+            while (getline(fin, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || line[0] == '#')
+                    continue;
+                const int number = int(results.size() + 1);
+                results.push_back(pool.submit([this, line, number]() { return analyse_line(line, number).dump(); }));
+            }
+            for (auto &res : results)
+            {
+                fout << res.get() << "\n";
+                ++count;
+            }
+        }
+#ifdef CHECKERS_TRACE
+        Trace::write_logged(project_path + string((*config)("Trace", "File")), project_path + "log.txt");
+#endif
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << "Positions analysis: " << count << " positions, " << int(sec * 1000) << " millisec\n";
+        cout << "Positions analysis: " << count << " positions\n";
+        return 0;
+    }
+
+    // Анализ одной строки файла: лучшие ходы, оценки и главные варианты. number - номер позиции
+    // в файле (с 1) для выбора трассы секции "Trace"
+    json analyse_line(const string &line, const int number = 0)
+    {
+        json res;
+        const size_t space = line.find_first_of(" \t");
+        const string fen = line.substr(0, space);
+        res["fen"] = fen;
+        const size_t id = line.find_first_not_of(" \t", space);
+        if (space != string::npos && id != string::npos)
+            res["id"] = line.substr(id, line.find_last_not_of(" \t") + 1 - id);
+
+        vector<vector<POS_T>> mtx;
+        bool color;
+        if (!Notation::parse_fen(fen, mtx, color))
+        {
+            res["error"] = "bad FEN";
+            return res;
+        }
+        const int depth = (*config)("Positions", "Depth");
+        const double time_ms = (*config)("Positions", "TimeMS");
+        const size_t multi_pv = (*config)("Positions", "MultiPV");
+
+        auto logic = take_logic();
+        search_limits limits;
+        if (time_ms > 0)
+            limits.set_time(time_ms);
+        logic->set_limits(&limits);
+        logic->set_trace(number == int((*config)("Trace", "Position")));
+        auto start = chrono::steady_clock::now();
+        int done_depth = -1;
+        auto lines = logic->iterate(mtx, color, depth, multi_pv,
+                                    [&done_depth](int d, const vector<analysis_line> &) { done_depth = d; });
+        res["depth"] = done_depth;
+        res["nodes"] = logic->get_nodes();
+        res["time_ms"] = int(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        logic->set_limits(nullptr);
+        give_logic(move(logic));
+
+        if (!lines.empty())
+            res["bestmove"] = Notation::turn_name(lines[0].turns);
+        res["lines"] = json::array();
+        for (auto &line : lines)
+        {
+            json pv = json::array({Notation::turn_name(line.turns)});
+            for (auto &turn : line.pv)
+                pv.push_back(Notation::turn_name(turn));
+            res["lines"].push_back({{"move", Notation::turn_name(line.turns)}, {"score", line.score}, {"pv", pv}});
+        }
+        return res;
+    }
+
+private:
+    // Логика на время анализа одной позиции: хеш-таблица переходит от позиции к позиции
+    unique_ptr<Logic> take_logic()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (!logics.empty())
+            {
+                auto logic = move(logics.back());
+                logics.pop_back();
+                return logic;
+            }
+        }
+        auto logic = make_unique<Logic>(nullptr, config);
+        logic->set_hash_size_mb((*config)("Positions", "HashSizeMB"));
+        logic->set_mcts_threads(mcts_threads);
+        return logic;
+    }
+
+    void give_logic(unique_ptr<Logic> logic)
+    {
+        lock_guard<mutex> lock(mtx);
+        logics.push_back(move(logic));
+    }
+
+private:
+    Config *config; // указатель на Config
+    mutex mtx;
+    vector<unique_ptr<Logic>> logics; // свободные логики потоков
+    size_t mcts_threads = 1; // потоков на дерево MCTS каждой логики (доля ядер на поток пула)
+};
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../Models/Position_record.h"
+
+// Заголовок файла позиций: магия, версия формата, размер записи
+const char Position_file_magic[4] = {'C', 'K', 'P', 'S'};
+const uint16_t Position_file_version = 1;
+
+// Дозапись партий в бинарный файл позиций, безопасна для нескольких потоков
+class Position_writer
+{
+public:
+    Position_writer(const std::string &path)
+    {
+        fout.open(path, std::ios_base::binary | std::ios_base::app);
+        if (!fout)
+            throw std::runtime_error("can't open position file " + path);
+        fout.seekp(0, std::ios_base::end);
+        if (fout.tellp() == 0)
+        {
+            // Новый файл - пишем заголовок
+            uint16_t header[2] = {Position_file_version, uint16_t(sizeof(position_record))};
+            fout.write(Position_file_magic, sizeof(Position_file_magic));
+            fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+        }
+    }
+
+    // Записывает все позиции одной партии одним блоком
+    void write(const std::vector<position_record> &records)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fout.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(position_record));
+        written += records.size();
+    }
+
+    size_t count() const
+    {
+        return written;
+    }
+
+private:
+    std::ofstream fout;
+    std::mutex mtx;
+    size_t written = 0; // записано позиций этим писателем
+};
+
+// Потоковое чтение файла позиций блоками, не загружая файл целиком
+class Position_reader
+{
+public:
+    Position_reader(const std::string &path, const size_t block_size = 4096) : buffer(block_size)
+    {
+        fin.open(path, std::ios_base::binary);
+        if (!fin)
+            throw std::runtime_error("can't open position file " + path);
+        char magic[4];
+        uint16_t header[2];
+        fin.read(magic, sizeof(magic));
+        fin.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!fin || memcmp(magic, Position_file_magic, sizeof(magic)) != 0 || header[0] != Position_file_version ||
+            header[1] != sizeof(position_record))
+            throw std::runtime_error("bad position file header " + path);
+    }
+
+    // Возвращает следующую позицию, false в конце файла
+    bool next(position_record &rec)
+    {
+        if (pos == size)
+        {
+            fin.read(reinterpret_cast<char *>(buffer.data()), buffer.size() * sizeof(position_record));
+            size = size_t(fin.gcount()) / sizeof(position_record);
+            pos = 0;
+            if (size == 0)
+                return false;
+        }
+        rec = buffer[pos++];
+        return true;
+    }
+
+private:
+    std::ifstream fin;
+    std::vector<position_record> buffer;
+    size_t pos = 0;
+    size_t size = 0;
+};
+
+// Файл позиций целиком в памяти только для чтения: на POSIX отображается в адресное пространство
+// (страницы подгружает и делит между процессами система), на Windows читается в буфер
+class Position_map
+{
+public:
+    Position_map(const std::string &path)
+    {
+#ifdef _WIN32
+        std::ifstream fin(path, std::ios_base::binary | std::ios_base::ate);
+        if (!fin)
+            throw std::runtime_error("can't open position file " + path);
+        buffer.resize(size_t(fin.tellg()));
+        fin.seekg(0);
+        fin.read(buffer.data(), buffer.size());
+        check_header(path, buffer.data(), buffer.size());
+        records = reinterpret_cast<const position_record *>(buffer.data() + Header_size);
+        count = (buffer.size() - Header_size) / sizeof(position_record);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("can't open position file " + path);
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            map_size = size_t(st.st_size);
+            map_base = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map_base == MAP_FAILED)
+                map_base = nullptr;
+        }
+        ::close(fd); // отображение остаётся после закрытия дескриптора
+        if (!map_base)
+            throw std::runtime_error("can't map position file " + path);
+        madvise(map_base, map_size, MADV_SEQUENTIAL);
+        const char *base = static_cast<const char *>(map_base);
+        check_header(path, base, map_size);
+        records = reinterpret_cast<const position_record *>(base + Header_size);
+        count = (map_size - Header_size) / sizeof(position_record);
+#endif
+    }
+
+    Position_map(const Position_map &) = delete;
+    Position_map &operator=(const Position_map &) = delete;
+
+    ~Position_map()
+    {
+#ifndef _WIN32
+        if (map_base)
+            munmap(map_base, map_size);
+#endif
+    }
+
+    const position_record *data() const
+    {
+        return records;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    void check_header(const std::string &path, const char *base, const size_t bytes)
+    {
+        uint16_t header[2];
+        if (bytes >= Header_size)
+            memcpy(header, base + sizeof(Position_file_magic), sizeof(header));
+        if (bytes < Header_size || memcmp(base, Position_file_magic, sizeof(Position_file_magic)) != 0 ||
+            header[0] != Position_file_version || header[1] != sizeof(position_record))
+        {
+#ifndef _WIN32
+            munmap(map_base, map_size);
+            map_base = nullptr;
+#endif
+            throw std::runtime_error("bad position file header " + path);
+        }
+    }
+
+private:
+    static const size_t Header_size = sizeof(Position_file_magic) + 2 * sizeof(uint16_t);
+    const position_record *records = nullptr;
+    size_t count = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#else
+    void *map_base = nullptr;
+    size_t map_size = 0;
+#endif
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Notation.h"
+
+// Решение одной позиции (режим "Checkers solve <FEN> [узлы]"): решатель df-pn доказывает выигрыш,
+// проигрыш или ничью в пределах горизонта Plies секции "Solver" и печатает доказанный вариант
+class Position_solver
+{
+public:
+    Position_solver(Config *config) : config(config)
+    {
+    }
+
+    // fen - позиция, max_nodes - предел узлов, пустая строка - ToolNodes из секции "Solver"
+    int run(const string &fen, const string &max_nodes = "")
+    {
+        vector<vector<POS_T>> mtx;
+        bool color;
+        if (!Notation::parse_fen(fen, mtx, color))
+        {
+            cout << "Bad FEN: " << fen << "\n";
+            return 1;
+        }
+        size_t nodes = (*config)("Solver", "ToolNodes");
+        if (!max_nodes.empty())
+            nodes = strtoull(max_nodes.c_str(), nullptr, 10);
+        Logic logic(nullptr, config);
+        auto start = chrono::steady_clock::now();
+        auto info = logic.solve(mtx, color, nodes);
+        const int ms = int(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+
+        const string side = color ? "black" : "white";
+        string result = "unknown (node limit reached)";
+        if (info.result == Solve_result::WIN)
+            result = side + " wins in " + to_string(info.plies) + " plies";
+        else if (info.result == Solve_result::LOSS)
+            result = side + " loses in " + to_string(info.plies) + " plies";
+        else if (info.result == Solve_result::DRAW)
+            result = "draw (no forced win within " + to_string(int((*config)("Solver", "Plies"))) + " plies)";
+        cout << "Result: " << result << "\n";
+        if (!info.pv.empty())
+        {
+            cout << "Best move: " << Notation::turn_name(info.pv[0]) << "\nProof:";
+            for (auto &turn : info.pv)
+                cout << " " << Notation::turn_name(turn);
+            cout << "\n";
+        }
+        cout << "Nodes: " << info.nodes << ", " << ms << " millisec\n";
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << "Solve " << fen << ": " << result << ", " << info.nodes << " nodes, " << ms << " millisec\n";
+        return 0;
+    }
+
+private:
+    Config *config; // указатель на Config
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+
+#include "../Models/Move.h"
+
+// Геометрия доски Size x Size: фигуры на тёмных полях ((i + j) % 2 == 1), белые внизу (строки с
+// большими номерами) и ходят к строке 0. Всё известно при компиляции, так что логика,
+// собранная под один вариант, не платит за проверки другого
+template <int N> struct Board_geometry
+{
+    static constexpr POS_T Size = N;               // сторона доски
+    static constexpr int Squares = N * N / 2;      // тёмных полей
+    static constexpr POS_T Start_rows = (N - 2) / 2; // рядов шашек каждой стороны в начале партии
+    // Строка превращения по типу фигуры: белая шашка - 0, черная - последняя, дамки не превращаются
+    static constexpr POS_T Promotion_row[5] = {-1, 0, N - 1, -1, -1};
+
+    // Номер тёмного поля: с верхней строки, слева направо
+    static constexpr int index(const POS_T x, const POS_T y)
+    {
+        return x * (N / 2) + y / 2;
+    }
+
+    static std::vector<std::vector<POS_T>> start_mtx()
+    {
+        std::vector<std::vector<POS_T>> res(N, std::vector<POS_T>(N, 0));
+        for (POS_T i = 0; i < N; ++i)
+        {
+            for (POS_T j = 0; j < N; ++j)
+            {
+                if ((i + j) % 2 == 0)
+                    continue;
+                if (i < Start_rows)
+                    res[i][j] = 2; // черные
+                else if (i >= N - Start_rows)
+                    res[i][j] = 1; // белые
+            }
+        }
+        return res;
+    }
+};
+
+// Русские шашки: 8x8, дамки ходят на любое расстояние, бить можно любую серию, шашка,
+// дошедшая в серии ударов до последней строки, продолжает бить уже дамкой
+struct Russian_rules : Board_geometry<8>
+{
+    static constexpr bool Flying_kings = true;
+    static constexpr bool Capture_majority = false; // обязательно бить наибольшее число фигур
+    static constexpr bool Promote_in_capture = true; // превращение посреди серии ударов
+};
+
+// Международные шашки: 10x10, бить обязательно наибольшее число фигур, шашка превращается,
+// только если серия ударов на последней строке закончилась
+struct International_rules : Board_geometry<10>
+{
+    static constexpr bool Flying_kings = true;
+    static constexpr bool Capture_majority = true;
+    static constexpr bool Promote_in_capture = false;
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "../Models/Position_record.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Logic.h"
+#include "Position_file.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Генератор партий бот против бота без окна. Каждая позиция партии записывается
+// в бинарный файл вместе с оценкой поиска и итогом партии (данные для ML)
+class SelfPlay
+{
+public:
+    SelfPlay(Config *config) : config(config)
+    {
+    }
+
+    // Играет настроенное в секции "SelfPlay" число партий, возвращает 0 при успехе
+    int run()
+    {
+        const size_t games = (*config)("SelfPlay", "Games");
+        const size_t threads = (*config)("SelfPlay", "Threads");
+        const unsigned seed = (*config)("SelfPlay", "Seed");
+        const string output = (*config)("SelfPlay", "OutputFile");
+
+        auto start = chrono::steady_clock::now();
+        Position_writer writer(project_path + output);
+        atomic<size_t> finished{0};
+#ifdef CHECKERS_TRACE
+        Trace::start(false); // пишет только партия Trace.Game
+#endif
+        {
+            ThreadPool pool(threads);
+            const size_t mcts_threads = ThreadPool::threads_per_task(pool.size());
+            for (size_t game = 0; game < games; ++game)
+            {
+                // У каждой партии своё зерно - партии воспроизводимы независимо от числа потоков
+                pool.submit([this, &writer, &finished, game, games, seed, mcts_threads]() {
+                    writer.write(play_game(unsigned(seed + game), int(game + 1), mcts_threads));
+                    size_t done = ++finished;
+                    if (done % Report_every_games == 0 || done == games)
+                        cout << "Self-play: " << done << "/" << games << " games\n";
+                });
+            }
+            pool.wait();
+        }
+#ifdef CHECKERS_TRACE
+        Trace::write_logged(project_path + string((*config)("Trace", "File")), project_path + "log.txt");
+#endif
+        auto end = chrono::steady_clock::now();
+
+        double sec = chrono::duration<double>(end - start).count();
+        ofstream fout(project_path + "log.txt", ios_base::app);
+        fout << "Self-play: " << games << " games, " << writer.count() << " positions, " << int(sec * 1000)
+             << " millisec, " << int(writer.count() / max(sec, 1e-9)) << " positions/sec\n";
+        fout.close();
+        return 0;
+    }
+
+    // Одна партия: случайный дебют, затем ходы бота с записью позиций. game_number - номер партии
+    // запуска (с 1) для выбора трассы секции "Trace", mcts_threads - потоков на дерево MCTS
+    vector<position_record> play_game(const unsigned seed, const int game_number = 0,
+                                      const size_t mcts_threads = 1) const
+    {
+        const int max_turns = (*config)("Game", "MaxNumTurns");
+        const int opening_plies = (*config)("SelfPlay", "RandomOpeningPlies");
+        const trace_plies traced{(*config)("Trace", "Game"), (*config)("Trace", "FromPly"), (*config)("Trace", "ToPly")};
+
+        Logic logic(nullptr, config);
+        logic.set_seed(seed);
+        logic.set_hash_size_mb((*config)("SelfPlay", "HashSizeMB"));
+        logic.set_mcts_threads(mcts_threads);
+        logic.Max_depth = (*config)("SelfPlay", "BotLevel");
+        default_random_engine rand_eng(seed);
+        // Длина случайного дебюта тоже случайна, чтобы партии расходились сильнее
+        const int random_plies = uniform_int_distribution<int>(0, opening_plies)(rand_eng);
+
+        vector<position_record> records;
+        auto mtx = Board::start_mtx();
+        int result = 0; // ничья при достижении MaxNumTurns
+        for (int turn_num = 0; turn_num < max_turns; ++turn_num)
+        {
+            const bool color = turn_num % 2;
+            logic.find_turns(color, mtx);
+            if (logic.turns.empty())
+            {
+                result = color ? 1 : 2; // у ходящего нет ходов - он проиграл
+                break;
+            }
+            if (turn_num < random_plies)
+            {
+                // Случайный ход, серия ударов тоже случайная
+                while (true)
+                {
+                    auto turn = logic.turns[rand_eng() % logic.turns.size()];
+                    mtx = logic.make_turn(mtx, turn);
+                    if (turn.xb == -1)
+                        break;
+                    logic.find_turns(turn.x2, turn.y2, mtx);
+                    if (!logic.have_beats)
+                        break;
+                }
+                continue;
+            }
+            logic.set_trace(traced.contains(game_number, turn_num));
+            auto turns = logic.find_best_turns(mtx, color);
+            records.emplace_back(mtx, color, float(logic.last_score), uint16_t(turn_num));
+            for (auto turn : turns)
+                mtx = logic.make_turn(mtx, turn);
+        }
+        for (auto &rec : records)
+            rec.result = int8_t(result);
+        return records;
+    }
+
+private:
+    const size_t Report_every_games = 1000; // как часто печатать прогресс
+    Config *config; // указатель на Config
+};
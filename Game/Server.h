@@ -0,0 +1,626 @@
+#pragma once
+#ifndef _WIN32
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../Models/Analysis.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Engine_protocol.h"
+#include "Logic.h"
+#include "Notation.h"
+#include "ThreadPool.h"
+#include "Time_manager.h"
+#include "Transposition_table.h"
+
+// Задержки ходов за последнее время: кольцо из limit замеров, перцентили по запросу
+class Latency_window
+{
+public:
+    explicit Latency_window(const size_t limit = 1000) : limit(max<size_t>(limit, 1))
+    {
+    }
+
+    void add(const double ms)
+    {
+        if (samples.size() < limit)
+            samples.push_back(ms);
+        else
+            samples[next] = ms;
+        next = (next + 1) % limit;
+        ++total;
+    }
+
+    // "moves N p50 X p90 Y p99 Z max W", задержки в миллисекундах
+    string report() const
+    {
+        vector<double> sorted = samples;
+        sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](const double p) {
+            if (sorted.empty())
+                return 0.0;
+            const size_t rank = size_t(ceil(p * sorted.size()));
+            return sorted[min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+        };
+        ostringstream out;
+        out << "moves " << total << " p50 " << int(percentile(0.5)) << " p90 " << int(percentile(0.9)) << " p99 "
+            << int(percentile(0.99)) << " max " << int(sorted.empty() ? 0 : sorted.back());
+        return out.str();
+    }
+
+private:
+    size_t limit;
+    vector<double> samples;
+    size_t next = 0;
+    size_t total = 0; // ходов всего, не только в окне
+};
+
+// Партия одного клиента сервера. Поля позиции и расписания меняются под замком сервера
+struct server_session
+{
+    explicit server_session(const int fd, const size_t latency_samples) : fd(fd), latency(latency_samples)
+    {
+    }
+
+    ~server_session()
+    {
+        close(fd);
+    }
+
+    // Строка клиенту; ответы потока сокетов и рабочих потоков не перемешиваются
+    void send_line(const string &s)
+    {
+        lock_guard<mutex> lock(out_mtx);
+        const string line = s + "\n";
+        size_t sent = 0;
+        while (sent < line.size())
+        {
+            const ssize_t n = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return; // клиент ушёл, сессию закроет поток сокетов
+            sent += size_t(n);
+        }
+    }
+
+    int fd;
+    string input; // принятые байты без конца строки
+    mutex out_mtx;
+    vector<vector<POS_T>> mtx = Logic::start_mtx(); // текущая позиция
+    bool color = 0; // сторона хода
+    int priority = 1; // вес в честном расписании
+    double virtual_ms = 0; // время рабочих потоков, потраченное на сессию, делённое на priority
+    bool busy = false; // ход в очереди или считается
+    bool stop = false; // команда stop пришла раньше начала поиска
+    search_limits *running = nullptr; // лимиты рабочего потока, который считает ход
+    double last_scores[2] = {0, 0}; // оценки прошлых ходов по часам каждой стороны
+    Latency_window latency; // от команды go до bestmove
+};
+
+// Ход, ждущий рабочего потока
+struct server_job
+{
+    shared_ptr<server_session> session;
+    vector<vector<POS_T>> mtx;
+    bool color = 0;
+    int depth = Max_iterate_depth;
+    size_t nodes = 0;
+    double budget_ms = 0; // время хода от прихода команды, 0 - без ограничения
+    bool by_clock = false; // ход по часам: глубины прекращает Time_manager
+    Time_manager time;
+    chrono::steady_clock::time_point received;
+
+    double elapsed_ms() const
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - received).count();
+    }
+};
+
+// Сервер движка (режим "Checkers server [сокет]"): много партий одновременно через сокет домена Unix.
+// Клиент - одна партия, команды по строкам как в протоколе engine: newgame, position, go, stop,
+// priority N, stats, serverstats, isready, quit. Ходы всех партий считает общий пул рабочих потоков
+// с общей хеш-таблицей. Расписание честное: поток получает партия, потратившая меньше всего времени
+// пула с поправкой на приоритет, но ход, у которого до конца бюджета осталось меньше UrgentMS,
+// идёт первым (ближайший срок раньше). Ожидание в очереди входит в бюджет хода
+class Server
+{
+public:
+    Server(Config *config) : config(config), parser(nullptr, config)
+    {
+        socket_path = (*config)("Server", "Socket").get<string>();
+        worker_count = (*config)("Server", "Workers");
+        if (worker_count == 0)
+            worker_count = max(1u, thread::hardware_concurrency());
+        max_sessions = (*config)("Server", "MaxSessions");
+        max_priority = max(1, int((*config)("Server", "MaxPriority")));
+        urgent_ms = (*config)("Server", "UrgentMS");
+        default_move_ms = (*config)("Server", "DefaultMoveMS");
+        latency_samples = (*config)("Server", "LatencySamples");
+        overhead_ms = (*config)("Clock", "MoveOverheadMS");
+        table = make_shared<Transposition_table>();
+        table->resize((*config)("Server", "HashSizeMB"));
+        table->make_concurrent();
+    }
+
+    // socket - путь сокета, пустая строка - Socket из секции "Server". Работает до SIGINT или SIGTERM
+    int run(const string &socket = "")
+    {
+        if (!socket.empty())
+            socket_path = socket;
+        const int listen_fd = open_socket();
+        if (listen_fd < 0)
+        {
+            cout << "Cannot listen on " << socket_path << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        for (size_t i = 0; i < worker_count; ++i)
+            workers.emplace_back(new worker(config, table, ThreadPool::threads_per_task(worker_count)));
+        for (auto &w : workers)
+            w->th = thread(&Server::work, this, w.get());
+        cout << "Listening on " << socket_path << ", " << worker_count << " workers\n";
+
+        map<int, shared_ptr<server_session>> sessions;
+        vector<pollfd> fds;
+        while (!interrupted())
+        {
+            fds.assign(1, pollfd{listen_fd, POLLIN, 0});
+            for (auto &s : sessions)
+                fds.push_back(pollfd{s.first, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), Poll_ms) <= 0)
+                continue;
+            if (fds[0].revents & POLLIN)
+                accept_session(listen_fd, sessions);
+            for (size_t k = 1; k < fds.size(); ++k)
+            {
+                if (!fds[k].revents)
+                    continue;
+                auto it = sessions.find(fds[k].fd);
+                if (it != sessions.end() && !receive(it->second))
+                {
+                    close_session(it->second);
+                    sessions.erase(it);
+                }
+            }
+        }
+
+        for (auto &s : sessions)
+            close_session(s.second);
+        {
+            lock_guard<mutex> lock(mtx);
+            is_exit = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers)
+            w->th.join();
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        const string stats = all_latency.report();
+        cout << "Server stopped: " << stats << "\n";
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << "Server " << socket_path << ", " << worker_count << " workers: " << stats << "\n";
+        return 0;
+    }
+
+private:
+    // Рабочий поток: своя логика (история отсечений, решатель) над общей хеш-таблицей
+    struct worker
+    {
+        worker(Config *config, shared_ptr<Transposition_table> table, const size_t mcts_threads)
+                : logic(nullptr, config)
+        {
+            logic.set_shared_table(move(table));
+            logic.set_limits(&limits);
+            logic.set_mcts_threads(mcts_threads);
+        }
+
+        Logic logic;
+        search_limits limits;
+        thread th;
+        size_t jobs = 0; // посчитано ходов
+    };
+
+    static atomic<bool> &interrupt_flag()
+    {
+        static atomic<bool> flag{false};
+        return flag;
+    }
+
+    static void on_signal(int)
+    {
+        interrupt_flag() = true;
+    }
+
+    static bool interrupted()
+    {
+        return interrupt_flag().load();
+    }
+
+    int open_socket()
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(addr.sun_path, socket_path.c_str());
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        unlink(socket_path.c_str()); // сокет прошлого запуска
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, Backlog) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void accept_session(const int listen_fd, map<int, shared_ptr<server_session>> &sessions)
+    {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        auto session = make_shared<server_session>(fd, latency_samples);
+        if (sessions.size() >= max_sessions)
+        {
+            session->send_line("error server full");
+            return;
+        }
+        lock_guard<mutex> lock(mtx);
+        session->virtual_ms = virtual_clock; // новая партия не получает фору за прошлое
+        ++active_sessions;
+        sessions[fd] = session;
+    }
+
+    // Партия закрыта: её ход убирается из очереди, идущий поиск останавливается
+    void close_session(const shared_ptr<server_session> &session)
+    {
+        lock_guard<mutex> lock(mtx);
+        --active_sessions;
+        pending.erase(remove_if(pending.begin(), pending.end(),
+                                [&session](const unique_ptr<server_job> &job) { return job->session == session; }),
+                      pending.end());
+        if (session->running)
+            session->running->stop = true;
+        shutdown(session->fd, SHUT_RDWR);
+    }
+
+    // Чтение из сокета клиента и выполнение пришедших команд, false - клиент ушёл
+    bool receive(const shared_ptr<server_session> &session)
+    {
+        char buf[4096];
+        const ssize_t n = read(session->fd, buf, sizeof(buf));
+        if (n <= 0)
+            return false;
+        session->input.append(buf, size_t(n));
+        size_t end;
+        while ((end = session->input.find('\n')) != string::npos)
+        {
+            string line = session->input.substr(0, end);
+            session->input.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!command(session, line))
+                return false;
+        }
+        return session->input.size() <= Max_line;
+    }
+
+    // Команда клиента, false - quit
+    bool command(const shared_ptr<server_session> &session, const string &line)
+    {
+        istringstream cmd(line);
+        string word;
+        if (!(cmd >> word))
+            return true;
+        if (word == "quit")
+            return false;
+        if (word == "isready")
+        {
+            session->send_line("readyok");
+        }
+        else if (word == "newgame")
+        {
+            lock_guard<mutex> lock(mtx);
+            if (session->busy)
+                return busy(session);
+            session->mtx = Logic::start_mtx();
+            session->color = 0;
+            session->last_scores[0] = session->last_scores[1] = 0;
+        }
+        else if (word == "position")
+        {
+            lock_guard<mutex> lock(mtx);
+            if (session->busy)
+                return busy(session);
+            const string error = Notation::parse_position(parser, cmd, session->mtx, session->color);
+            if (!error.empty())
+                session->send_line("info string " + error);
+        }
+        else if (word == "go")
+        {
+            go(session, cmd);
+        }
+        else if (word == "stop")
+        {
+            lock_guard<mutex> lock(mtx);
+            if (session->running)
+                session->running->stop = true;
+            else if (session->busy)
+                session->stop = true; // ход ещё в очереди: поиск не начнётся
+        }
+        else if (word == "priority")
+        {
+            int priority = 0;
+            cmd >> priority;
+            lock_guard<mutex> lock(mtx);
+            session->priority = max(1, min(priority, max_priority));
+        }
+        else if (word == "stats")
+        {
+            lock_guard<mutex> lock(mtx);
+            session->send_line("stats " + session->latency.report());
+        }
+        else if (word == "serverstats")
+        {
+            lock_guard<mutex> lock(mtx);
+            ostringstream out;
+            out << "serverstats sessions " << active_sessions << " queued " << pending.size() << " searching "
+                << searching << " workers " << worker_count << " " << all_latency.report();
+            session->send_line(out.str());
+        }
+        else
+        {
+            session->send_line("info string unknown command " + word);
+        }
+        return true;
+    }
+
+    bool busy(const shared_ptr<server_session> &session)
+    {
+        session->send_line("info string busy");
+        return true;
+    }
+
+    // go [depth N] [movetime MS] [nodes N] [wtime MS] [btime MS] [winc MS] [binc MS] [movestogo N].
+    // Без лимитов ход получает DefaultMoveMS
+    void go(const shared_ptr<server_session> &session, istringstream &cmd)
+    {
+        auto job = make_unique<server_job>();
+        job->received = chrono::steady_clock::now();
+        double movetime = 0, time[2] = {0, 0}, increment[2] = {0, 0};
+        int moves_to_go = 0;
+        string word;
+        while (cmd >> word)
+        {
+            if (word == "depth")
+                cmd >> job->depth;
+            else if (word == "movetime")
+                cmd >> movetime;
+            else if (word == "nodes")
+                cmd >> job->nodes;
+            else if (word == "wtime")
+                cmd >> time[0];
+            else if (word == "btime")
+                cmd >> time[1];
+            else if (word == "winc")
+                cmd >> increment[0];
+            else if (word == "binc")
+                cmd >> increment[1];
+            else if (word == "movestogo")
+                cmd >> moves_to_go;
+        }
+        job->depth = max(0, min(job->depth, Max_iterate_depth));
+
+        lock_guard<mutex> lock(mtx);
+        if (session->busy)
+        {
+            busy(session);
+            return;
+        }
+        job->session = session;
+        job->mtx = session->mtx;
+        job->color = session->color;
+        const bool color = session->color;
+        if (movetime > 0)
+        {
+            job->budget_ms = movetime;
+        }
+        else if (time[color] > 0 && job->nodes == 0 && job->depth == Max_iterate_depth)
+        {
+            job->by_clock = true;
+            const size_t legal = Notation::legal_turns(parser, job->mtx, color).size();
+            job->time.start(time[color], increment[color], moves_to_go, overhead_ms, legal,
+                            session->last_scores[color]);
+            job->budget_ms = max(job->time.hard_ms(), 1.0);
+        }
+        else if (job->nodes == 0 && job->depth == Max_iterate_depth)
+        {
+            job->budget_ms = default_move_ms;
+        }
+        session->busy = true;
+        session->stop = false;
+        session->virtual_ms = max(session->virtual_ms, virtual_clock);
+        pending.push_back(move(job));
+        cv.notify_one();
+    }
+
+    // Следующий ход для рабочего потока: срочный с ближайшим сроком, иначе партии с наименьшим
+    // взвешенным временем пула. Вызывается под замком
+    unique_ptr<server_job> pick()
+    {
+        size_t best = 0;
+        double best_slack = 0;
+        bool urgent = false;
+        for (size_t k = 0; k < pending.size(); ++k)
+        {
+            const auto &job = pending[k];
+            if (job->budget_ms <= 0)
+                continue;
+            const double slack = job->budget_ms - job->elapsed_ms();
+            if (slack <= urgent_ms && (!urgent || slack < best_slack))
+            {
+                best = k;
+                best_slack = slack;
+                urgent = true;
+            }
+        }
+        if (!urgent)
+        {
+            for (size_t k = 1; k < pending.size(); ++k)
+            {
+                const auto &a = pending[k]->session, &b = pending[best]->session;
+                if (a->virtual_ms < b->virtual_ms ||
+                    (a->virtual_ms == b->virtual_ms && pending[k]->received < pending[best]->received))
+                    best = k;
+            }
+        }
+        auto job = move(pending[best]);
+        pending.erase(pending.begin() + best);
+        virtual_clock = max(virtual_clock, job->session->virtual_ms);
+        return job;
+    }
+
+    void work(worker *w)
+    {
+        TRACE_THREAD("server");
+        while (true)
+        {
+            unique_ptr<server_job> job;
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [this]() { return is_exit || !pending.empty(); });
+                if (is_exit)
+                    return;
+                job = pick();
+                w->limits.reset();
+                w->limits.stop = job->session->stop;
+                job->session->running = &w->limits;
+                ++searching;
+            }
+            const auto start = chrono::steady_clock::now();
+            string info;
+            const string best = search(*w, *job, info);
+            const double busy_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            auto &session = *job->session;
+            const double latency_ms = job->elapsed_ms();
+            {
+                lock_guard<mutex> lock(mtx);
+                session.running = nullptr;
+                session.busy = false;
+                session.virtual_ms += busy_ms / session.priority;
+                session.latency.add(latency_ms);
+                all_latency.add(latency_ms);
+                --searching;
+                // Поколение общей таблицы - примерно по ходу каждой партии
+                if (++finished % max<size_t>(active_sessions, 1) == 0)
+                    table->new_search();
+            }
+            session.send_line(info + " latency " + to_string(int(latency_ms)));
+            session.send_line("bestmove " + best);
+            // Партии не привязаны к потокам: глубокие результаты уходят в файл обучения по мере накопления
+            if (++w->jobs % Learn_flush_jobs == 0)
+                w->logic.learn_game(-1, false);
+        }
+    }
+
+    // Поиск хода задания рабочим потоком, info - строка итога поиска
+    string search(worker &w, server_job &job, string &info)
+    {
+        Logic &logic = w.logic;
+        if (job.budget_ms > 0)
+            w.limits.set_time(max(job.budget_ms - job.elapsed_ms(), 1.0));
+        w.limits.max_nodes = job.nodes;
+        auto legal = Notation::legal_turns(logic, job.mtx, job.color);
+        int done_depth = 0;
+        auto lines = logic.iterate(job.mtx, job.color, job.depth, 1, [&](int d, const vector<analysis_line> &found) {
+            done_depth = d;
+            if (!job.by_clock || found.empty())
+                return;
+            const auto &best = found[0];
+            if (!job.time.next_depth(job.elapsed_ms(), best.turns, best.score, opponent_beats(logic, job, best.turns)))
+                w.limits.stop = true; // следующую глубину не начинаем
+        });
+        if (lines.empty() && !legal.empty())
+        {
+            // Бюджет кончился в очереди или до первой глубины: любой допустимый ход лучше просрочки
+            analysis_line line;
+            line.turns = legal[0];
+            lines.push_back(line);
+        }
+        ostringstream out;
+        out << "info depth " << done_depth << " score "
+            << Engine_protocol::score_name(lines.empty() ? 0 : lines[0].score) << " nodes " << logic.get_nodes();
+        info = out.str();
+        if (lines.empty())
+            return "none";
+        if (job.by_clock)
+        {
+            lock_guard<mutex> lock(mtx);
+            job.session->last_scores[job.color] = lines[0].score;
+        }
+        return Notation::turn_name(lines[0].turns);
+    }
+
+    // После хода turns соперник обязан бить
+    static bool opponent_beats(Logic &logic, const server_job &job, const vector<move_pos> &turns)
+    {
+        auto next = job.mtx;
+        for (auto &turn : turns)
+            next = logic.make_turn(next, turn);
+        logic.find_turns(!job.color, next);
+        return logic.have_beats;
+    }
+
+    static const int Poll_ms = 200; // как часто поток сокетов проверяет сигнал остановки
+    static const int Backlog = 128;
+    static const size_t Max_line = 1 << 16; // клиент без конца строки отключается
+    static const size_t Learn_flush_jobs = 64;
+
+    Config *config; // указатель на Config
+    Logic parser; // разбор позиций и ходов в потоке сокетов
+    shared_ptr<Transposition_table> table; // общая хеш-таблица рабочих потоков
+    string socket_path;
+    size_t worker_count;
+    size_t max_sessions;
+    int max_priority;
+    double urgent_ms;
+    double default_move_ms;
+    size_t latency_samples;
+    double overhead_ms;
+    vector<unique_ptr<worker>> workers;
+
+    mutex mtx; // очередь, поля сессий и статистика
+    condition_variable cv;
+    deque<unique_ptr<server_job>> pending; // ходы в очереди
+    double virtual_clock = 0; // взвешенное время последнего выбранного хода
+    size_t active_sessions = 0;
+    size_t searching = 0;
+    size_t finished = 0;
+    Latency_window all_latency{10000};
+    bool is_exit = false;
+};
+#endif
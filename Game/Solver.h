@@ -0,0 +1,380 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../Models/Move.h"
+#include "Transposition_table.h"
+
+// Итог решения позиции для ходящей стороны
+enum class Solve_result : uint8_t
+{
+    UNKNOWN, // не хватило узлов
+    WIN,     // выигрыш доказан
+    LOSS,    // проигрыш доказан
+    DRAW     // ни одна сторона не может выиграть за горизонт (повторения считаются ничьей)
+};
+
+struct solve_info
+{
+    Solve_result result = Solve_result::UNKNOWN;
+    std::vector<std::vector<move_pos>> pv; // доказанный вариант: быстрейший выигрыш или самое долгое сопротивление
+    int plies = 0;                         // длина доказанного выигрыша или проигрыша в полуходах
+    size_t nodes = 0;
+};
+
+// Запись таблицы решателя. Числа доказательства и опровержения - для стороны attacker ("выигрывает ли она").
+// len зависит от итога: у доказанного узла - длина выигрыша (годится при горизонте не меньше),
+// у опровергнутого - наибольший горизонт, при котором опровержение верно, у нерешённого - горизонт расчёта
+// (его числа - лишь оценки и годятся при любом горизонте)
+struct pn_entry
+{
+    uint64_t key = 0;
+    uint32_t pn = 0, dn = 0;
+    int16_t len = 0;
+    uint32_t work = 0; // узлов в поддереве, при вытеснении остаются дорогие записи
+};
+
+// Решатель df-pn (поиск по числам доказательства в глубину) для позиций с малым числом фигур:
+// доказывает выигрыш стороны в пределах горизонта полуходов, не больше заданного числа узлов.
+// Ход - цепочка ударов целиком, ходы генерирует логика L. Таблица ограничена по памяти
+// (корзины по две записи) и живёт между решениями: доказанное не зависит от истории партии
+class Solver
+{
+public:
+    void set_hash_size_mb(const size_t size_mb)
+    {
+        hash_size_mb = size_mb;
+        table.clear();
+    }
+
+    void clear()
+    {
+        table.assign(table.size(), pn_entry());
+    }
+
+    // Решение позиции mtx с ходом color: сначала доказывается выигрыш ходящего, при опровержении -
+    // выигрыш соперника. stop проверяется в каждом узле (лимиты поиска логики)
+    template <class L>
+    solve_info solve(L &logic, const std::vector<std::vector<POS_T>> &mtx, const bool color, const int max_plies,
+                     const size_t max_nodes, const std::function<bool()> &stop = nullptr)
+    {
+        if (table.empty())
+            resize();
+        nodes = 0;
+        budget = max_nodes;
+        stop_fn = stop;
+        stopped = false;
+        solve_info res;
+        const board_hash hash = Zobrist::get().hash(mtx);
+        size = int(mtx.size());
+        const int plies = std::max(0, std::min(max_plies, int(Len_max) - 1));
+        uint32_t win_dn = 1, loss_dn = 1;
+        if (prove(logic, mtx, color, color, hash, plies, res.plies, win_dn) == 0)
+        {
+            res.result = Solve_result::WIN;
+        }
+        else if (!stopped)
+        {
+            const uint32_t loss_pn = prove(logic, mtx, color, !color, hash, plies, res.plies, loss_dn);
+            if (loss_pn == 0)
+                res.result = Solve_result::LOSS;
+            else if (win_dn == 0 && loss_dn == 0)
+                res.result = Solve_result::DRAW;
+        }
+        if (res.result == Solve_result::WIN || res.result == Solve_result::LOSS)
+        {
+            attacker = (res.result == Solve_result::WIN) ? color : !color;
+            res.pv = proof_line(logic, mtx, color, hash, res.plies);
+            if (res.pv.empty() && res.plies > 0)
+                res.result = Solve_result::UNKNOWN; // запись корня вытеснена, хода нет
+        }
+        else
+        {
+            res.plies = 0;
+        }
+        res.nodes = nodes;
+        stop_fn = nullptr;
+        return res;
+    }
+
+private:
+    struct child
+    {
+        std::vector<std::vector<POS_T>> mtx;
+        std::vector<move_pos> turn;
+        uint64_t key;
+    };
+
+    void resize()
+    {
+        size_t count = 2;
+        while (count * 2 * sizeof(pn_entry) <= hash_size_mb * 1024 * 1024)
+            count *= 2;
+        table.assign(count, pn_entry());
+        mask = count - 1;
+    }
+
+    // Ключ узла: доказанное не зависит от оценки, поэтому позиция и её отражение всегда делят запись
+    uint64_t key_of(const board_hash &hash, const bool color) const
+    {
+        return Zobrist::get().node_key(hash, color, attacker, -1, -1, size, true);
+    }
+
+    // Доказательство выигрыша who: возвращает число доказательства корня (0 - доказано),
+    // в dn - число опровержения (0 - опровергнуто), в len - длину доказанного выигрыша
+    template <class L>
+    uint32_t prove(L &logic, const std::vector<std::vector<POS_T>> &mtx, const bool color, const bool who,
+                   const board_hash &hash, const int plies, int &len, uint32_t &dn)
+    {
+        attacker = who;
+        path.clear();
+        uint32_t pn = 1;
+        dn = 1;
+        int16_t l = 0;
+        const uint64_t key = key_of(hash, color);
+        if (!lookup(key, plies, pn, dn, l) || (pn != 0 && dn != 0))
+            mid(logic, mtx, color, key, plies, Pn_inf, Pn_inf);
+        pn = dn = 1;
+        lookup(key, plies, pn, dn, l);
+        len = l;
+        return pn;
+    }
+
+    // Одна итерация df-pn: узел раскрывается, пока его числа не достигли порогов
+    template <class L>
+    void mid(L &logic, const std::vector<std::vector<POS_T>> &mtx, const bool color, const uint64_t key,
+             const int remaining, const uint32_t th_pn, const uint32_t th_dn)
+    {
+        if (++nodes >= budget || (stop_fn && stop_fn()))
+        {
+            stopped = true;
+            return;
+        }
+        const size_t start_nodes = nodes;
+        const bool is_or = (color == attacker);
+        auto children = expand(logic, mtx, color);
+        if (children.empty())
+        {
+            // Ходов нет - ходящий проиграл; проигрыш атакующего верен при любом горизонте
+            if (is_or)
+                store(key, Pn_inf, 0, Len_max, 1);
+            else
+                store(key, 0, Pn_inf, 0, 1);
+            return;
+        }
+        if (remaining == 0)
+        {
+            store(key, Pn_inf, 0, 0, 1); // горизонт: выигрыша за отведённые полуходы нет
+            return;
+        }
+        for (auto &c : children)
+            c.key = key_of(Zobrist::get().hash(c.mtx), !color);
+
+        path.push_back(key);
+        std::vector<uint32_t> pns(children.size()), dns(children.size());
+        std::vector<int16_t> lens(children.size());
+        uint32_t pn = 1, dn = 1;
+        int16_t len = int16_t(remaining);
+        while (true)
+        {
+            for (size_t k = 0; k < children.size(); ++k)
+            {
+                pns[k] = dns[k] = 1;
+                lens[k] = 0;
+                if (std::find(path.begin(), path.end(), children[k].key) != path.end())
+                    pns[k] = Pn_inf, dns[k] = 0; // повторение позиции - ничья, выигрыша нет
+                else
+                    lookup(children[k].key, remaining - 1, pns[k], dns[k], lens[k]);
+            }
+            // В узле атакующего нужен один доказанный ход, в узле защиты - все
+            const auto &to_min = is_or ? pns : dns;
+            const auto &to_sum = is_or ? dns : pns;
+            uint32_t min_value = Pn_inf;
+            uint64_t sum = 0;
+            for (size_t k = 0; k < children.size(); ++k)
+            {
+                min_value = std::min(min_value, to_min[k]);
+                sum = (to_sum[k] == Pn_inf || sum == Pn_inf) ? Pn_inf : std::min<uint64_t>(sum + to_sum[k], Pn_inf - 1);
+            }
+            pn = is_or ? min_value : uint32_t(sum);
+            dn = is_or ? uint32_t(sum) : min_value;
+            if (pn == 0 || dn == 0)
+            {
+                len = result_len(pn == 0, is_or, pns, dns, lens);
+                break;
+            }
+            if (pn >= th_pn || dn >= th_dn || stopped)
+                break;
+
+            // Ребёнок с наименьшим числом для стороны хода и второй за ним (пороги по 1+eps)
+            size_t best = 0;
+            uint32_t second = Pn_inf;
+            for (size_t k = 1; k < children.size(); ++k)
+            {
+                if (to_min[k] < to_min[best])
+                {
+                    second = to_min[best];
+                    best = k;
+                }
+                else
+                {
+                    second = std::min(second, to_min[k]);
+                }
+            }
+            const uint32_t th_own = is_or ? th_pn : th_dn;
+            const uint32_t th_other = is_or ? th_dn : th_pn;
+            const uint64_t other = is_or ? dn : pn;
+            const uint32_t child_own =
+                    std::min<uint64_t>(th_own, second >= Pn_inf - 1 ? Pn_inf : second + second / 4 + 1);
+            const uint32_t child_other = uint32_t(std::min<uint64_t>(th_other - other + to_sum[best], Pn_inf));
+            mid(logic, children[best].mtx, !color, children[best].key, remaining - 1, is_or ? child_own : child_other,
+                is_or ? child_other : child_own);
+        }
+        path.pop_back();
+        store(key, pn, dn, len, uint32_t(std::min<size_t>(nodes - start_nodes + 1, UINT32_MAX)));
+    }
+
+    // len решённого узла по детям: длина выигрыша - быстрейший ход атакующего и самая долгая защита,
+    // горизонт опровержения - по ребёнку, опровергнутому при самом коротком горизонте
+    static int16_t result_len(const bool proven, const bool is_or, const std::vector<uint32_t> &pns,
+                              const std::vector<uint32_t> &dns, const std::vector<int16_t> &lens)
+    {
+        // Доказано в узле атакующего (или опровергнуто в узле защиты) - одним ребёнком, лучшим;
+        // иначе - всеми детьми, решает худший
+        const bool by_one = (proven == is_or);
+        int res = by_one ? (proven ? Len_max : 0) : (proven ? 0 : Len_max);
+        for (size_t k = 0; k < pns.size(); ++k)
+        {
+            if ((proven ? pns[k] : dns[k]) != 0)
+                continue;
+            if (proven)
+                res = by_one ? std::min<int>(res, lens[k]) : std::max<int>(res, lens[k]);
+            else
+                res = by_one ? std::max<int>(res, lens[k]) : std::min<int>(res, lens[k]);
+        }
+        return int16_t(std::min(res + 1, int(Len_max)));
+    }
+
+    // Доказанный вариант из таблицы: атакующий выбирает быстрейший выигрыш, защита - самую долгую
+    template <class L>
+    std::vector<std::vector<move_pos>> proof_line(L &logic, std::vector<std::vector<POS_T>> mtx, bool color,
+                                                  const board_hash &hash, int remaining)
+    {
+        std::vector<std::vector<move_pos>> res;
+        std::vector<uint64_t> seen{key_of(hash, color)};
+        while (remaining > 0)
+        {
+            auto children = expand(logic, mtx, color);
+            const bool is_or = (color == attacker);
+            int best = -1, best_len = 0;
+            for (size_t k = 0; k < children.size(); ++k)
+            {
+                const uint64_t key = key_of(Zobrist::get().hash(children[k].mtx), !color);
+                uint32_t pn = 1, dn = 1;
+                int16_t len = 0;
+                if (!lookup(key, remaining - 1, pn, dn, len) || pn != 0 ||
+                    std::find(seen.begin(), seen.end(), key) != seen.end())
+                    continue;
+                if (best == -1 || (is_or ? len < best_len : len > best_len))
+                {
+                    best = int(k);
+                    best_len = len;
+                }
+            }
+            if (best == -1)
+                break; // конец варианта или записи вытеснены
+            res.push_back(children[best].turn);
+            seen.push_back(key_of(Zobrist::get().hash(children[best].mtx), !color));
+            mtx = children[best].mtx;
+            color = !color;
+            remaining = best_len;
+        }
+        return res;
+    }
+
+    // Полные ходы color (цепочки ударов целиком, как Notation::legal_turns) с досками после них
+    template <class L> std::vector<child> expand(L &logic, const std::vector<std::vector<POS_T>> &mtx, const bool color)
+    {
+        std::vector<child> res;
+        logic.find_turns(color, mtx);
+        auto turns = logic.turns;
+        std::vector<move_pos> chain;
+        add_children(logic, mtx, turns, logic.have_beats, chain, res);
+        return res;
+    }
+
+    template <class L>
+    void add_children(L &logic, const std::vector<std::vector<POS_T>> &mtx, const std::vector<move_pos> &turns,
+                      const bool beats, std::vector<move_pos> &chain, std::vector<child> &res)
+    {
+        for (auto &turn : turns)
+        {
+            chain.push_back(turn);
+            auto next = logic.make_turn(mtx, turn);
+            if (beats)
+                logic.find_turns(turn.x2, turn.y2, next);
+            if (beats && logic.have_beats)
+            {
+                auto next_turns = logic.turns;
+                add_children(logic, next, next_turns, true, chain, res);
+            }
+            else
+            {
+                logic.finish_series(next, turn);
+                res.push_back({next, chain, 0});
+            }
+            chain.pop_back();
+        }
+    }
+
+    // Числа узла key при горизонте remaining; false - записи нет или её итог при этом горизонте неверен
+    bool lookup(const uint64_t key, const int remaining, uint32_t &pn, uint32_t &dn, int16_t &len) const
+    {
+        const size_t index = key & mask & ~size_t(1);
+        for (size_t k = index; k < index + 2; ++k)
+        {
+            const pn_entry &e = table[k];
+            if (e.key != key || e.work == 0)
+                continue;
+            const bool fits = (e.pn == 0 && remaining >= e.len) || (e.dn == 0 && remaining <= e.len) ||
+                              (e.pn != 0 && e.dn != 0);
+            if (!fits)
+                return false;
+            pn = e.pn;
+            dn = e.dn;
+            len = e.len;
+            return true;
+        }
+        return false;
+    }
+
+    // Запись в корзину из двух: та же позиция или запись с меньшим поддеревом
+    void store(const uint64_t key, const uint32_t pn, const uint32_t dn, const int16_t len, const uint32_t work)
+    {
+        const size_t index = key & mask & ~size_t(1);
+        pn_entry *slot = &table[index];
+        if (table[index + 1].key == key || (slot->key != key && table[index + 1].work < slot->work))
+            slot = &table[index + 1];
+        slot->key = key;
+        slot->pn = pn;
+        slot->dn = dn;
+        slot->len = len;
+        slot->work = std::max<uint32_t>(work, 1);
+    }
+
+    static constexpr uint32_t Pn_inf = 1u << 30; // бесконечное число: узел решён
+    static constexpr int16_t Len_max = 10000;    // проигрыш без ходов - при любом горизонте
+
+    std::vector<pn_entry> table;
+    size_t mask = 0;
+    size_t hash_size_mb = 16;
+    bool attacker = false;               // сторона, выигрыш которой доказывается
+    int size = 8;                        // сторона доски решаемой позиции
+    std::vector<uint64_t> path;          // ключи узлов текущего пути для поиска повторений
+    size_t nodes = 0;
+    size_t budget = 0;
+    bool stopped = false;
+    std::function<bool()> stop_fn;
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с очередью задач у каждого потока и кражей работы (самоигра, пакетный анализ).
+// Поток берёт задачи из конца своей очереди, а когда она пуста - из начала чужих, так что
+// долгие задачи (глубокие позиции) не держат остальные потоки без дела
+class ThreadPool
+{
+public:
+    ThreadPool(size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads; ++i)
+            queues.emplace_back(new worker_queue());
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back(&ThreadPool::loop, this, i);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            is_exit = true;
+        }
+        cv.notify_all();
+        for (auto &th : workers)
+            th.join();
+    }
+
+    // Ставит задачу в очередь, результат приходит через future. Задача из потока пула
+    // попадает в его собственную очередь, внешние задачи раздаются по очереди
+    template <class F> auto submit(F f) -> std::future<decltype(f())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+        auto res = task->get_future();
+        const size_t index = (current_pool() == this) ? current_index() : next_queue++ % queues.size();
+        {
+            // Счётчики растут раньше, чем задачу можно взять из очереди
+            std::lock_guard<std::mutex> lock(mtx);
+            ++unfinished;
+            ++queued;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mtx);
+            queues[index]->tasks.emplace_back([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return res;
+    }
+
+    // Ждёт выполнения всех поставленных задач
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [this]() { return unfinished == 0; });
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    // Потоков на одну задачу (дерево MCTS), чтобы задачи threads потоков вместе не заняли больше ядер
+    static size_t threads_per_task(const size_t threads)
+    {
+        return std::max<size_t>(1, std::thread::hardware_concurrency() / std::max<size_t>(threads, 1));
+    }
+
+private:
+    struct worker_queue
+    {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static const ThreadPool *&current_pool()
+    {
+        thread_local const ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &current_index()
+    {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    // Своя задача с конца очереди или чужая с начала, false если задач нет
+    bool pop_task(const size_t index, std::function<void()> &task)
+    {
+        for (size_t k = 0; k < queues.size(); ++k)
+        {
+            worker_queue &q = *queues[(index + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void loop(const size_t index)
+    {
+        current_pool() = this;
+        current_index() = index;
+        while (true)
+        {
+            std::function<void()> task;
+            if (!pop_task(index, task))
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return is_exit || queued != 0; });
+                if (queued == 0)
+                    return; // выход только после выполнения очереди
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                --queued;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (--unfinished == 0)
+                    done_cv.notify_all();
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<worker_queue>> queues; // очереди потоков
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::condition_variable done_cv;
+    std::atomic<size_t> next_queue{0}; // очередь для следующей внешней задачи
+    size_t unfinished = 0; // поставлено, но ещё не выполнено
+    size_t queued = 0;     // лежит в очередях
+    bool is_exit = false;
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../Models/Move.h"
+#include "Board.h"
+#include "Config.h"
+
+// Часы партии: BaseTimeMS на MovesPerPeriod ходов каждой стороне (0 - на всю партию),
+// IncrementMS добавляется после каждого хода. Настройки - секция "Clock"
+class Game_clock
+{
+public:
+    Game_clock(Config *config)
+    {
+        base_ms = (*config)("Clock", "BaseTimeMS");
+        increment_ms = (*config)("Clock", "IncrementMS");
+        moves_per_period = (*config)("Clock", "MovesPerPeriod");
+        overhead_ms = (*config)("Clock", "MoveOverheadMS");
+        reset();
+    }
+
+    // Игра с часами (BaseTimeMS > 0)
+    bool enabled() const
+    {
+        return base_ms > 0;
+    }
+
+    // Новая партия: у обеих сторон полное время
+    void reset()
+    {
+        for (int color = 0; color < 2; ++color)
+        {
+            remaining[color] = base_ms;
+            moves[color] = 0;
+        }
+    }
+
+    double remaining_ms(const bool color) const
+    {
+        return remaining[color];
+    }
+
+    double get_increment_ms() const
+    {
+        return increment_ms;
+    }
+
+    double get_overhead_ms() const
+    {
+        return overhead_ms;
+    }
+
+    // Ходов до конца периода, 0 - период на всю партию
+    int moves_to_go(const bool color) const
+    {
+        return moves_per_period > 0 ? moves_per_period - moves[color] % moves_per_period : 0;
+    }
+
+    // Ход color занял used_ms. false - время вышло (ход сделан после падения флага)
+    bool spend(const bool color, const double used_ms)
+    {
+        remaining[color] -= used_ms;
+        if (remaining[color] < 0)
+            return false;
+        remaining[color] += increment_ms;
+        if (moves_per_period > 0 && ++moves[color] % moves_per_period == 0)
+            remaining[color] += base_ms; // новый период
+        return true;
+    }
+
+    // Контроль времени для тега TimeControl PDN: "40/300+2" - 40 ходов на 300 с и 2 с за ход
+    string time_control() const
+    {
+        string res = (moves_per_period > 0 ? to_string(moves_per_period) + "/" : "") + seconds(base_ms);
+        if (increment_ms > 0)
+            res += "+" + seconds(increment_ms);
+        return res;
+    }
+
+private:
+    static string seconds(const double ms)
+    {
+        string res = to_string(ms / 1000);
+        res.erase(res.find_last_not_of('0') + 1);
+        if (res.back() == '.')
+            res.pop_back();
+        return res;
+    }
+
+    double base_ms = 0;
+    double increment_ms = 0;
+    int moves_per_period = 0;
+    double overhead_ms = 0; // запас на задержки потоков и окна, бот его не тратит
+    double remaining[2]; // остаток времени сторон
+    int moves[2]; // сделано ходов с начала партии
+};
+
+// Распределение времени на ход по часам. Поиск углубляется, пока прошедшее время не
+// подошло к норме хода; норма растёт в острых позициях (лучший ход меняется от глубины к глубине,
+// оценка упала относительно прошлого хода, соперник после лучшего хода обязан бить) и равна нулю
+// при единственном допустимом ходе. Жёсткий предел хода не даёт просрочить время
+class Time_manager
+{
+public:
+    // remaining_ms, increment_ms, moves_to_go - часы ходящей стороны, legal_turns - число допустимых
+    // ходов, prev_score - оценка прошлого хода этой стороны (0 - неизвестна)
+    void start(const double remaining_ms, const double increment_ms, const int moves_to_go,
+               const double overhead_ms, const size_t legal_turns, const double prev_score)
+    {
+        const double avail = max(0.0, remaining_ms - overhead_ms);
+        const int moves_left = moves_to_go > 0 ? moves_to_go : Default_moves_left;
+        optimum = min(avail, avail / moves_left + increment_ms * Increment_share);
+        maximum = min(avail * (moves_to_go == 1 ? Last_move_share : Max_share), optimum * Max_scale);
+        maximum = max(maximum, min(optimum, avail));
+        if (legal_turns == 1)
+            optimum = 0; // единственный ход: хватит первой глубины
+        last_score = prev_score;
+        best.clear();
+        unstable = 0;
+    }
+
+    // Норма хода, мс (без поправок на острую позицию)
+    double optimum_ms() const
+    {
+        return optimum;
+    }
+
+    // Жёсткий предел хода, мс: поиск останавливается, даже если глубина не досчитана
+    double hard_ms() const
+    {
+        return maximum;
+    }
+
+    // Глубина досчитана за elapsed_ms с лучшим ходом turns и оценкой score (отношение материала).
+    // opponent_beats - после этого хода соперник обязан бить. true - стоит искать глубже
+    bool next_depth(const double elapsed_ms, const vector<move_pos> &turns, const double score,
+                    const bool opponent_beats)
+    {
+        if (!best.empty() && turns != best)
+            unstable = Unstable_depths;
+        else if (unstable > 0)
+            --unstable;
+        best = turns;
+
+        double scale = 1;
+        if (unstable > 0)
+            scale *= Unstable_scale;
+        if (last_score > 0 && score < last_score / Score_drop)
+            scale *= Score_drop_scale;
+        if (opponent_beats)
+            scale *= Beats_scale;
+        // Следующая глубина дольше всех предыдущих вместе: начинаем её, только если прошла
+        // малая часть нормы
+        return elapsed_ms < min(optimum * scale, maximum) * Next_depth_share;
+    }
+
+private:
+    const int Default_moves_left = 30; // ходов до конца партии, если период не задан
+    const double Increment_share = 0.9; // доля добавки, которую можно потратить на текущий ход
+    const double Max_share = 0.3; // жёсткий предел - не больше этой доли остатка
+    const double Last_move_share = 0.8; // последний ход периода: остаток всё равно сгорит
+    const double Max_scale = 5; // жёсткий предел - не больше нормы, умноженной на это
+    const double Next_depth_share = 0.5; // новая глубина начинается до этой доли нормы
+    const int Unstable_depths = 2; // сколько глубин после смены лучшего хода позиция считается острой
+    const double Unstable_scale = 1.8;
+    const double Score_drop = 1.1; // падение оценки в столько раз - острая позиция
+    const double Score_drop_scale = 1.5;
+    const double Beats_scale = 1.3;
+
+    double optimum = 0; // норма хода, мс
+    double maximum = 0; // жёсткий предел хода, мс
+    double last_score = 0;
+    vector<move_pos> best; // лучший ход прошлой глубины
+    int unstable = 0;
+};
@@ -0,0 +1,268 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+// Зона трассировки: имя (строковый литерал) и отметки начала и конца в тактах счётчика
+struct trace_event
+{
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Профилировщик зон трассировки. Зоны пишутся без замков в буфер своего потока между start и stop,
+// write сохраняет их в формате Chrome trace event JSON (открывается в Perfetto и chrome://tracing).
+// Вызывать start и write, только пока поиски не идут: буферы потоков читаются без замка
+class Trace
+{
+public:
+    // Отметка времени: счётчик тактов процессора (TSC), на других процессорах - steady_clock в нс
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        return __rdtsc();
+#else
+        return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    static bool is_active()
+    {
+        const state &s = get();
+        return s.active.load(std::memory_order_relaxed) &&
+               (s.all_threads.load(std::memory_order_relaxed) || thread_enabled());
+    }
+
+    // Начало записи: старые зоны всех потоков стираются. all_threads false - пишут только потоки
+    // внутри поисков с флагом трассы (Logic::set_trace), остальные партии пула не мешают
+    static void start(const bool all_threads = true)
+    {
+        state &s = get();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        for (auto &buf : s.buffers)
+        {
+            buf->events.clear();
+            buf->dropped = 0;
+        }
+        s.start_ticks = now();
+        s.start_time = std::chrono::steady_clock::now();
+        s.all_threads = all_threads;
+        s.active = true;
+    }
+
+    // Запись зон текущего потока при start(false)
+    static bool &thread_enabled()
+    {
+        thread_local bool enabled = false;
+        return enabled;
+    }
+
+    // Конец записи, зоны остаются в буферах до следующего start
+    static void stop()
+    {
+        state &s = get();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        if (!s.active)
+            return;
+        s.active = false;
+        s.stop_ticks = now();
+        s.stop_time = std::chrono::steady_clock::now();
+    }
+
+    // Имя текущего потока в трассе ("gui", "engine")
+    static void set_thread_name(const char *name)
+    {
+        local().name = name;
+    }
+
+    static void record(const char *name, const uint64_t begin, const uint64_t end)
+    {
+        thread_buffer &buf = local();
+        if (buf.events.size() == Max_events_per_thread)
+        {
+            ++buf.dropped;
+            return;
+        }
+        buf.events.push_back({name, begin, end});
+    }
+
+    // Сохранение записанных зон, false - файл не открылся
+    static bool write(const std::string &path)
+    {
+        stop();
+        state &s = get();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        std::ofstream fout(path);
+        if (!fout)
+            return false;
+        // Такты переводятся в микросекунды по отношению длительностей записи в тактах и по steady_clock
+        const double us = std::chrono::duration<double, std::micro>(s.stop_time - s.start_time).count();
+        const double ticks_per_us = (us > 0 && s.stop_ticks > s.start_ticks) ? (s.stop_ticks - s.start_ticks) / us : 1;
+        fout << std::fixed << std::setprecision(3); // микросекунды с точностью до наносекунды
+        fout << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        for (auto &buf : s.buffers)
+        {
+            if (buf->events.empty() && buf->name.empty())
+                continue;
+            fout << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->tid
+                 << ",\"args\":{\"name\":\"" << (buf->name.empty() ? "thread " + std::to_string(buf->tid) : buf->name)
+                 << "\"}}";
+            first = false;
+            for (auto &e : buf->events)
+            {
+                const double ts = e.begin > s.start_ticks ? (e.begin - s.start_ticks) / ticks_per_us : 0;
+                const double dur = e.end > e.begin ? (e.end - e.begin) / ticks_per_us : 0;
+                fout << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->tid
+                     << ",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+            }
+            if (buf->dropped > 0)
+            {
+                fout << ",\n{\"name\":\"dropped " << buf->dropped << " zones\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+                     << buf->tid << ",\"ts\":0}";
+            }
+        }
+        fout << "\n]}\n";
+        return bool(fout);
+    }
+
+    // Сохранение с отметкой в логе log_path: куда записана трасса или ошибка
+    static bool write_logged(const std::string &path, const std::string &log_path)
+    {
+        const bool ok = write(path);
+        std::ofstream fout(log_path, std::ios_base::app);
+        if (ok)
+            fout << "Trace written to " << path << "\n";
+        else
+            fout << "Error: can't write trace to " << path << "\n";
+        return ok;
+    }
+
+private:
+    struct thread_buffer
+    {
+        uint32_t tid = 0;
+        std::string name;
+        std::vector<trace_event> events;
+        size_t dropped = 0; // зоны сверх Max_events_per_thread
+    };
+
+    struct state
+    {
+        std::mutex mtx;
+        std::vector<std::shared_ptr<thread_buffer>> buffers; // буферы всех потоков, живут до конца программы
+        std::atomic<bool> active{false};
+        std::atomic<bool> all_threads{true}; // false - только потоки с thread_enabled
+        uint64_t start_ticks = 0, stop_ticks = 0;
+        std::chrono::steady_clock::time_point start_time, stop_time;
+    };
+
+    static state &get()
+    {
+        static state s;
+        return s;
+    }
+
+    // Буфер текущего потока, регистрируется при первой зоне потока
+    static thread_buffer &local()
+    {
+        thread_local std::shared_ptr<thread_buffer> buf;
+        if (!buf)
+        {
+            buf = std::make_shared<thread_buffer>();
+            buf->events.reserve(Initial_events);
+            state &s = get();
+            std::lock_guard<std::mutex> lock(s.mtx);
+            buf->tid = uint32_t(s.buffers.size() + 1);
+            s.buffers.push_back(buf);
+        }
+        return *buf;
+    }
+
+    static constexpr size_t Initial_events = 1 << 16;
+    static constexpr size_t Max_events_per_thread = 1 << 22; // 96 МБ зон на поток
+};
+
+// Зона от создания до конца области видимости, пишется только во время записи трассы
+class Trace_zone
+{
+public:
+    explicit Trace_zone(const char *zone_name) : name(Trace::is_active() ? zone_name : nullptr)
+    {
+        if (name)
+            begin = Trace::now();
+    }
+
+    ~Trace_zone()
+    {
+        if (name)
+            Trace::record(name, begin, Trace::now());
+    }
+
+    Trace_zone(const Trace_zone &) = delete;
+    Trace_zone &operator=(const Trace_zone &) = delete;
+
+private:
+    const char *name;
+    uint64_t begin = 0;
+};
+
+// Поиск с флагом трассы: зоны потока пишутся до конца области видимости (вложенный поиск без флага
+// запись не выключает)
+class Trace_search
+{
+public:
+    explicit Trace_search(const bool on) : prev(Trace::thread_enabled())
+    {
+        Trace::thread_enabled() = prev || on;
+    }
+
+    ~Trace_search()
+    {
+        Trace::thread_enabled() = prev;
+    }
+
+    Trace_search(const Trace_search &) = delete;
+    Trace_search &operator=(const Trace_search &) = delete;
+
+private:
+    bool prev;
+};
+
+// Полуходы под трассу из секции "Trace": партия номер game (с 1), полуходы [from, to), to 0 - до конца
+struct trace_plies
+{
+    int game = 0;
+    int from = 0;
+    int to = 0;
+
+    bool contains(const int game_number, const int ply) const
+    {
+        return game_number == game && ply >= from && (to <= 0 || ply < to);
+    }
+};
+
+// Зоны собираются только с -DCHECKERS_TRACE, иначе макросы пусты и горячие пути не меняются
+#ifdef CHECKERS_TRACE
+#define TRACE_JOIN_IMPL(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_IMPL(a, b)
+#define TRACE_ZONE(name) Trace_zone TRACE_JOIN(trace_zone_, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::set_thread_name(name)
+#define TRACE_SEARCH(on) Trace_search TRACE_JOIN(trace_search_, __LINE__)(on)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_THREAD(name)
+#define TRACE_SEARCH(on)
+#endif
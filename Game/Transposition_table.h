@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+#include "../Models/Move.h"
+#include "Rules.h"
+#include "Trace.h"
+
+const int Max_board_size = 10; // наибольшая доска среди вариантов (International_rules)
+
+// Хеш расстановки и её отражения: цвета фигур поменяны, доска повёрнута на 180°. Отражение позиции
+// с ходом соперника - та же позиция для другой стороны, поэтому кэши позиций могут хранить одну
+// запись на пару (Zobrist::node_key)
+struct board_hash
+{
+    uint64_t direct = 0;
+    uint64_t mirror = 0;
+
+    board_hash &operator^=(const board_hash &d)
+    {
+        direct ^= d.direct;
+        mirror ^= d.mirror;
+        return *this;
+    }
+    board_hash operator^(const board_hash &d) const
+    {
+        return {direct ^ d.direct, mirror ^ d.mirror};
+    }
+};
+
+// Случайные ключи Zobrist для хеширования позиций поиска
+struct Zobrist
+{
+    uint64_t piece[5][Max_board_size][Max_board_size]; // [тип фигуры][строка][столбец], тип 0 не используется
+    uint64_t color[2];       // ходящая сторона
+    uint64_t bot[2];         // чьими глазами считается оценка (она не симметрична)
+    uint64_t series[Max_board_size][Max_board_size]; // фигура, продолжающая серию ударов
+
+    Zobrist()
+    {
+        std::mt19937_64 rand_eng(0x5EED); // фиксированное зерно: ключи одинаковы между запусками
+        for (auto &type : piece)
+            for (auto &row : type)
+                for (auto &v : row)
+                    v = rand_eng();
+        for (auto &v : color)
+            v = rand_eng();
+        for (auto &v : bot)
+            v = rand_eng();
+        for (auto &row : series)
+            for (auto &v : row)
+                v = rand_eng();
+    }
+
+    static const Zobrist &get()
+    {
+        static const Zobrist keys;
+        return keys;
+    }
+
+    // Ключ фигуры type на поле (i, j) доски size x size и её отражения: фигура другого цвета
+    // на повёрнутом поле
+    board_hash piece_key(const POS_T type, const int i, const int j, const int size) const
+    {
+        return {piece[type][i][j], piece[Mirror_type[type]][size - 1 - i][size - 1 - j]};
+    }
+
+    // Хеш расстановки фигур (без стороны хода)
+    board_hash hash(const std::vector<std::vector<POS_T>> &mtx) const
+    {
+        const int size = int(mtx.size());
+        board_hash h;
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j)
+                if (mtx[i][j])
+                    h ^= piece_key(mtx[i][j], i, j, size);
+        return h;
+    }
+
+    // Изменение хеша расстановки после хода turn на доске mtx (до хода) по правилам Rules
+    template <class Rules = Russian_rules>
+    board_hash delta(const std::vector<std::vector<POS_T>> &mtx, const move_pos &turn) const
+    {
+        POS_T type = mtx[turn.x][turn.y];
+        POS_T new_type = type;
+        if (turn.x2 == Rules::Promotion_row[type] && (Rules::Promote_in_capture || turn.xb == -1))
+            new_type += 2;
+        board_hash d = piece_key(type, turn.x, turn.y, Rules::Size) ^ piece_key(new_type, turn.x2, turn.y2, Rules::Size);
+        if (turn.xb != -1)
+            d ^= piece_key(mtx[turn.xb][turn.yb], turn.xb, turn.yb, Rules::Size);
+        return d;
+    }
+
+    // Ключ узла: расстановка h, сторона хода side, сторона оценки eval_side и фигура серии ударов (x, y).
+    // symmetric - результат узла не меняется при отражении (с ходом и оценкой за другой цвет): тогда
+    // узел и отражение получают один ключ, представитель пары - позиция с ходом белых
+    uint64_t node_key(const board_hash &h, const bool side, const bool eval_side, const POS_T x, const POS_T y,
+                      const int size, const bool symmetric) const
+    {
+        const bool flip = symmetric && side;
+        uint64_t key = (flip ? h.mirror : h.direct) ^ color[side != flip] ^ bot[eval_side != flip];
+        if (x != -1)
+            key ^= flip ? series[size - 1 - x][size - 1 - y] : series[x][y];
+        return key;
+    }
+
+    // Ход в координатах отражённой доски (ход записи таблицы у отражённого узла)
+    static move_pos mirror_turn(const move_pos &turn, const int size)
+    {
+        const POS_T last = POS_T(size - 1);
+        move_pos res(last - turn.x, last - turn.y, last - turn.x2, last - turn.y2);
+        if (turn.xb != -1)
+        {
+            res.xb = last - turn.xb;
+            res.yb = last - turn.yb;
+        }
+        return res;
+    }
+
+    static constexpr POS_T Mirror_type[5] = {0, 2, 1, 4, 3}; // тип фигуры после смены цветов
+};
+
+// Тип оценки в записи таблицы
+enum class Bound : uint8_t
+{
+    NONE,  // пустая запись
+    EXACT, // точная оценка
+    LOWER, // оценка не меньше value (отсечение по beta)
+    UPPER  // оценка не больше value (все ходы хуже alpha)
+};
+
+struct tt_entry
+{
+    uint64_t key = 0;
+    double value = 0;
+    int8_t depth = -1;            // оставшаяся глубина поиска записи
+    Bound bound = Bound::NONE;
+    uint8_t generation = 0;       // номер поиска, в котором запись сделана
+    POS_T x = -1, y = -1;         // лучший ход узла
+    POS_T x2 = -1, y2 = -1;
+};
+
+// Хеш-таблица поиска: результаты узлов с границами и лучшим ходом,
+// живёт между поисками и между вариантами многовариантного анализа
+class Transposition_table
+{
+public:
+    Transposition_table() = default;
+
+    bool empty() const
+    {
+        return table.empty();
+    }
+
+    void resize(const size_t size_mb)
+    {
+        size_t count = 1;
+        while (count * 2 * sizeof(tt_entry) <= size_mb * 1024 * 1024)
+            count *= 2;
+        table.assign(count, tt_entry());
+        mask = count - 1;
+    }
+
+    void clear()
+    {
+        table.assign(table.size(), tt_entry());
+    }
+
+    // Таблица нескольких потоков (логики сервера): записи читаются и пишутся под замками полос,
+    // номер поиска общий. Вызывается до начала поисков
+    void make_concurrent()
+    {
+        sync = std::make_shared<concurrent_state>();
+    }
+
+    bool is_concurrent() const
+    {
+        return sync != nullptr;
+    }
+
+    // Новый поиск: старые записи вытесняются в первую очередь
+    void new_search()
+    {
+        if (sync)
+            sync->generation.fetch_add(1, std::memory_order_relaxed);
+        else
+            ++generation;
+    }
+
+    // Копия записи узла key в res, false - записи нет
+    bool probe(const uint64_t key, tt_entry &res) const
+    {
+        TRACE_ZONE("tt_probe");
+        const size_t index = key & mask;
+        std::unique_lock<std::mutex> lock;
+        if (sync)
+            lock = std::unique_lock<std::mutex>(sync->stripes[index % Lock_stripes]);
+        const tt_entry &e = table[index];
+        if (e.bound == Bound::NONE || e.key != key)
+            return false;
+        res = e;
+        return true;
+    }
+
+    // Запись с вытеснением по глубине: старые поиски и более мелкие записи заменяются
+    void store(const uint64_t key, const double value, const int depth, const Bound bound, const move_pos *best)
+    {
+        TRACE_ZONE("tt_store");
+        const size_t index = key & mask;
+        std::unique_lock<std::mutex> lock;
+        uint8_t cur_generation = generation;
+        if (sync)
+        {
+            lock = std::unique_lock<std::mutex>(sync->stripes[index % Lock_stripes]);
+            cur_generation = sync->generation.load(std::memory_order_relaxed);
+        }
+        tt_entry &e = table[index];
+        const bool same = (e.bound != Bound::NONE && e.key == key);
+        if (!same && e.bound != Bound::NONE && e.generation == cur_generation && e.depth > depth)
+            return;
+        if (same && e.depth > depth && e.generation == cur_generation && bound != Bound::EXACT)
+            return;
+        e.key = key;
+        e.value = value;
+        e.depth = int8_t(depth);
+        e.bound = bound;
+        e.generation = cur_generation;
+        if (best)
+        {
+            e.x = best->x;
+            e.y = best->y;
+            e.x2 = best->x2;
+            e.y2 = best->y2;
+        }
+        else if (!same)
+        {
+            e.x = -1; // ход от чужой позиции не годится
+        }
+    }
+
+private:
+    static const size_t Lock_stripes = 4096; // замков на таблицу: потоки редко ждут друг друга
+
+    struct concurrent_state
+    {
+        std::vector<std::mutex> stripes = std::vector<std::mutex>(Lock_stripes);
+        std::atomic<uint8_t> generation{0};
+    };
+
+    std::vector<tt_entry> table;
+    size_t mask = 0;
+    uint8_t generation = 0;
+    std::shared_ptr<concurrent_state> sync; // nullptr - таблица одного потока
+};
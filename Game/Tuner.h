@@ -0,0 +1,251 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <memory>
+
+#include "../Models/Position_record.h"
+#include "../Models/Project_path.h"
+#include "Board.h"
+#include "Config.h"
+#include "Eval_weights.h"
+#include "Leaf_batch.h"
+#include "Position_file.h"
+#include "ThreadPool.h"
+
+// Подбор весов оценки по количеству фигур (режим "Checkers tune") по размеченным позициям файла
+// самоигры или разбора партий: оценка переводится в ожидаемый итог p = 1 / (1 + (D / O)^S),
+// где O и D - взвешенный материал ходящей стороны и соперника, и минимизируется средний квадрат
+// ошибки p относительно итога партии. Файл позиций отображается в память, проходы по нему
+// делятся на куски между потоками пула. Сначала при прежних весах подбирается масштаб S,
+// затем веса дамки и продвижения - методом RPROP по знакам градиента
+class Tuner
+{
+public:
+    Tuner(Config *config) : config(config)
+    {
+    }
+
+    // input - файл позиций, пустая строка - InputFile из секции "Tune"
+    int run(string input = "")
+    {
+        if (input.empty())
+            input = string((*config)("Tune", "InputFile"));
+        const string mode = (*config)("Bot", "BotScoringType");
+        if (mode != "NumberOnly" && mode != "NumberAndPotential")
+        {
+            cout << "Tune: BotScoringType " << mode << " has no material weights\n";
+            return 1;
+        }
+        const size_t threads = (*config)("Tune", "Threads");
+        const int iterations = (*config)("Tune", "Iterations");
+        min_ply = (*config)("Tune", "MinPly");
+
+        auto start = chrono::steady_clock::now();
+        unique_ptr<Position_map> file;
+        try
+        {
+            file = make_unique<Position_map>(project_path + input);
+        }
+        catch (const exception &e)
+        {
+            cout << "Tune: " << e.what() << "\n";
+            return 1;
+        }
+        const Position_map &positions = *file;
+        ThreadPool pool(threads);
+
+        eval_weights w = eval_weights::defaults(mode);
+        fit_scale(pool, positions, w);
+        const pass_result before = pass(pool, positions, w);
+        if (before.count == 0)
+        {
+            cout << "Tune: no labelled positions in " << input << "\n";
+            return 1;
+        }
+        cout << "Tune: " << before.count << " positions, scale " << scale << ", loss " << before.loss() << "\n";
+
+        // RPROP: шаг каждого веса растёт, пока знак градиента держится, и уменьшается при смене знака
+        eval_weights best = w;
+        double best_loss = before.loss();
+        double step_king = 0.1, step_advance = 0.005;
+        double last_king = 0, last_advance = 0;
+        pass_result cur = before;
+        for (int it = 1; it <= iterations; ++it)
+        {
+            const double g_king = cur.grad_king / cur.count;
+            const double g_advance = cur.grad_advance / cur.count;
+            rprop_step(w.king, step_king, last_king, g_king, Min_king, Max_king);
+            if (mode == "NumberAndPotential")
+                rprop_step(w.advance, step_advance, last_advance, g_advance, 0, Max_advance);
+            cur = pass(pool, positions, w);
+            if (cur.loss() < best_loss)
+            {
+                best_loss = cur.loss();
+                best = w;
+            }
+            if (it % 10 == 0 || it == iterations)
+                cout << "Iteration " << it << ": king " << w.king << ", advance " << w.advance << ", loss "
+                     << cur.loss() << "\n";
+        }
+
+        const string output = (*config)("Tune", "OutputFile");
+        json info;
+        info["Positions"] = before.count;
+        info["Scale"] = scale;
+        info["LossBefore"] = before.loss();
+        info["LossAfter"] = best_loss;
+        if (!best.save(project_path + output, info))
+        {
+            cout << "Tune: can't write " << output << "\n";
+            return 1;
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        ofstream log(project_path + "log.txt", ios_base::app);
+        log << "Tune " << mode << ": " << before.count << " positions, " << iterations << " iterations, king "
+            << best.king << ", advance " << best.advance << ", loss " << before.loss() << " -> " << best_loss
+            << ", " << int(sec * 1000) << " millisec\n";
+        cout << "Tune: king " << best.king << ", advance " << best.advance << ", loss " << before.loss() << " -> "
+             << best_loss << ", written to " << output << "\n";
+        return 0;
+    }
+
+private:
+    // Суммы по позициям одного прохода
+    struct pass_result
+    {
+        size_t count = 0;
+        double error = 0;        // сумма квадратов ошибок
+        double grad_king = 0;    // суммы производных квадрата ошибки по весам
+        double grad_advance = 0;
+
+        double loss() const
+        {
+            return count ? error / count : 0;
+        }
+    };
+
+    // Ошибка и её градиент по позициям [from, to)
+    pass_result pass_range(const position_record *recs, const size_t from, const size_t to,
+                           const eval_weights &w) const
+    {
+        pass_result res;
+        for (size_t k = from; k < to; ++k)
+        {
+            const position_record &r = recs[k];
+            if (r.result < 0 || r.ply < min_ply)
+                continue;
+            const uint32_t wm = r.white & ~r.queens, bm = r.black & ~r.queens;
+            const int w_men = popcount32(wm), b_men = popcount32(bm);
+            const int w_kings = popcount32(r.white & r.queens), b_kings = popcount32(r.black & r.queens);
+            if (w_men + w_kings == 0 || b_men + b_kings == 0)
+                continue;
+            // продвижение пешек в строках: белые идут к строке 0, черные к последней
+            const int w_adv = (Size - 1) * w_men - row_sum32(wm), b_adv = row_sum32(bm);
+            const bool white_to_move = r.color == 0;
+            const int own_men = white_to_move ? w_men : b_men, opp_men = white_to_move ? b_men : w_men;
+            const int own_kings = white_to_move ? w_kings : b_kings, opp_kings = white_to_move ? b_kings : w_kings;
+            const int own_adv = white_to_move ? w_adv : b_adv, opp_adv = white_to_move ? b_adv : w_adv;
+            const double own = own_men + w.advance * own_adv + w.king * own_kings;
+            const double opp = opp_men + w.advance * opp_adv + w.king * opp_kings;
+            const double y = (r.result == 0) ? 0.5 : ((r.result == 1) == white_to_move ? 1 : 0);
+            const double p = 1 / (1 + exp(-scale * (log(own) - log(opp))));
+            const double d = p - y;
+            const double common = 2 * d * p * (1 - p) * scale;
+            ++res.count;
+            res.error += d * d;
+            res.grad_king += common * (own_kings / own - opp_kings / opp);
+            res.grad_advance += common * (own_adv / own - opp_adv / opp);
+        }
+        return res;
+    }
+
+    // Проход по всему файлу: куски по потокам пула, суммы складываются по порядку кусков
+    pass_result pass(ThreadPool &pool, const Position_map &positions, const eval_weights &w) const
+    {
+        const size_t n = positions.size();
+        const size_t chunks = pool.size() * Chunks_per_thread;
+        vector<future<pass_result>> parts;
+        parts.reserve(chunks);
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            const size_t from = n * c / chunks, to = n * (c + 1) / chunks;
+            parts.push_back(pool.submit(
+                    [this, &positions, &w, from, to]() { return pass_range(positions.data(), from, to, w); }));
+        }
+        pass_result total;
+        for (auto &part : parts)
+        {
+            pass_result r = part.get();
+            total.count += r.count;
+            total.error += r.error;
+            total.grad_king += r.grad_king;
+            total.grad_advance += r.grad_advance;
+        }
+        return total;
+    }
+
+    // Масштаб S при весах w: золотое сечение, ошибка от S одномодальна
+    void fit_scale(ThreadPool &pool, const Position_map &positions, const eval_weights &w)
+    {
+        const double phi = (sqrt(5.0) - 1) / 2;
+        double lo = Min_scale, hi = Max_scale;
+        auto loss_at = [&](const double s) {
+            scale = s;
+            return pass(pool, positions, w).loss();
+        };
+        double a = hi - phi * (hi - lo), b = lo + phi * (hi - lo);
+        double fa = loss_at(a), fb = loss_at(b);
+        for (int it = 0; it < Scale_iterations; ++it)
+        {
+            if (fa < fb)
+            {
+                hi = b;
+                b = a;
+                fb = fa;
+                a = hi - phi * (hi - lo);
+                fa = loss_at(a);
+            }
+            else
+            {
+                lo = a;
+                a = b;
+                fa = fb;
+                b = lo + phi * (hi - lo);
+                fb = loss_at(b);
+            }
+        }
+        scale = (lo + hi) / 2;
+    }
+
+    // Шаг RPROP для одного веса в пределах [lo, hi]
+    static void rprop_step(double &value, double &step, double &last_grad, const double grad, const double lo,
+                           const double hi)
+    {
+        if (grad * last_grad > 0)
+            step *= 1.2;
+        else if (grad * last_grad < 0)
+        {
+            step *= 0.5;
+            last_grad = 0; // после смены знака следующий шаг не сравнивается
+            return;
+        }
+        if (grad > 0)
+            value = max(lo, value - step);
+        else if (grad < 0)
+            value = min(hi, value + step);
+        last_grad = grad;
+    }
+
+private:
+    static const int Size = 8; // файл позиций - русские шашки 8x8
+    static const size_t Chunks_per_thread = 4;
+    static const int Scale_iterations = 30;
+    static constexpr double Min_scale = 0.05, Max_scale = 5;
+    static constexpr double Min_king = 1, Max_king = 20; // дамка не дешевле шашки
+    static constexpr double Max_advance = 0.5;
+
+    Config *config; // указатель на Config
+    int min_ply = 0; // позиции раньше этого полухода не используются (случайный дебют)
+    double scale = 1; // масштаб S перевода отношения материала в ожидаемый итог
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <vector>
+
+#include "Move.h"
+
+// Результат анализа одного хода корня
+struct analysis_line
+{
+    std::vector<move_pos> turns;           // Ход (цепочка ударов целиком)
+    double score = 0;                      // Оценка с точки зрения ходящей стороны
+    std::vector<std::vector<move_pos>> pv; // Главный вариант после хода, по полным ходам
+};
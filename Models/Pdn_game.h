@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// Партия в формате PDN: теги заголовка, ходы записью "c3-d4"/"c3:e5:g3" и результат
+struct pdn_game
+{
+    std::vector<std::pair<std::string, std::string>> tags; // Теги в порядке файла
+    std::vector<std::string> moves;                        // Полные ходы без номеров и комментариев
+    std::string result = "*";                              // "2-0", "0-2", "1-1" или "*"
+
+    // Значение тега, пустая строка если тега нет
+    std::string tag(const std::string &name) const
+    {
+        for (auto &t : tags)
+        {
+            if (t.first == name)
+                return t.second;
+        }
+        return "";
+    }
+
+    void set_tag(const std::string &name, const std::string &value)
+    {
+        for (auto &t : tags)
+        {
+            if (t.first == name)
+            {
+                t.second = value;
+                return;
+            }
+        }
+        tags.emplace_back(name, value);
+    }
+
+    // Итог в кодах файла позиций: 0 ничья, 1 победа белых, 2 победа черных, -1 неизвестен
+    int result_code() const
+    {
+        if (result == "2-0" || result == "1-0")
+            return 1;
+        if (result == "0-2" || result == "0-1")
+            return 2;
+        if (result == "1-1" || result == "1/2-1/2")
+            return 0;
+        return -1;
+    }
+};
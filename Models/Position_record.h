@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "Move.h"
+
+// Запись позиции в бинарном файле самоигры (20 байт)
+// Клетки нумеруются только по тёмным полям: index = i * 4 + j / 2
+struct position_record
+{
+    uint32_t white = 0;   // Маска белых фигур (шашки и дамки)
+    uint32_t black = 0;   // Маска черных фигур
+    uint32_t queens = 0;  // Маска дамок обоих цветов
+    float score = 0;      // Оценка поиска с точки зрения ходящей стороны
+    int8_t result = -1;   // Итог партии: 0 ничья, 1 победа белых, 2 победа черных, -1 неизвестен
+    uint8_t color = 0;    // Ходящая сторона: 0 белые, 1 черные
+    uint16_t ply = 0;     // Номер полухода в партии
+
+    position_record() = default;
+    position_record(const std::vector<std::vector<POS_T>> &mtx, const bool color, const float score, const uint16_t ply)
+            : score(score), color(color), ply(ply)
+    {
+        // Упаковка доски 8x8 в битовые маски
+        for (POS_T i = 0; i < 8; ++i)
+        {
+            for (POS_T j = (i + 1) % 2; j < 8; j += 2)
+            {
+                uint32_t bit = uint32_t(1) << (i * 4 + j / 2);
+                POS_T type = mtx[i][j];
+                if (type % 2 == 1)
+                    white |= bit;
+                else if (type)
+                    black |= bit;
+                if (type > 2)
+                    queens |= bit;
+            }
+        }
+    }
+
+    // Распаковка в матрицу доски
+    std::vector<std::vector<POS_T>> to_mtx() const
+    {
+        std::vector<std::vector<POS_T>> mtx(8, std::vector<POS_T>(8, 0));
+        for (POS_T i = 0; i < 8; ++i)
+        {
+            for (POS_T j = (i + 1) % 2; j < 8; j += 2)
+            {
+                uint32_t bit = uint32_t(1) << (i * 4 + j / 2);
+                if (white & bit)
+                    mtx[i][j] = 1;
+                else if (black & bit)
+                    mtx[i][j] = 2;
+                if (queens & bit)
+                    mtx[i][j] += 2;
+            }
+        }
+        return mtx;
+    }
+};
+
+static_assert(sizeof(position_record) == 20, "position_record must stay 20 bytes");
@@ -6,5 +6,6 @@ enum class Response
     BACK,    // Возврат хода
     REPLAY,  // Перезапуск игры
     QUIT,    // Выход из игры
-    CELL     // Выбор клетки на доске
+    CELL,    // Выбор клетки на доске
+    NEXT     // Следующий ход (просмотр разбора партии)
 };
@@ -1,7 +1,81 @@
+#include "Game/Bench.h"
+#include "Game/Engine_protocol.h"
+#include "Game/Pdn_analysis.h"
+#include "Game/Position_analysis.h"
+#include "Game/Position_solver.h"
 #include "Game/Game.h"
+#include "Game/Match.h"
+#include "Game/Network_trainer.h"
+#include "Game/SelfPlay.h"
+#include "Game/Server.h"
+#include "Game/Tuner.h"
 
 int main(int argc, char* argv[])
 {
+    // Консольный режим: генерация партий бот против бота без окна
+    if (argc > 1 && string(argv[1]) == "selfplay")
+    {
+        Config config;
+        return SelfPlay(&config).run();
+    }
+    // Консольный режим: микробенчмарки движка
+    if (argc > 1 && string(argv[1]) == "bench")
+    {
+        Config config;
+        return Bench(&config).run(argc > 2 ? argv[2] : "");
+    }
+    // Консольный режим: текстовый протокол движка для внешних программ
+    if (argc > 1 && string(argv[1]) == "engine")
+    {
+        Config config;
+        return Engine_protocol(&config).run();
+    }
+    // Консольный режим: проверка и оценка партий из архива PDN
+    if (argc > 1 && string(argv[1]) == "analyse")
+    {
+        Config config;
+        return Pdn_analysis(&config).run(argc > 2 ? argv[2] : "");
+    }
+    // Консольный режим: анализ списка позиций FEN со строками JSON на выходе
+    if (argc > 1 && string(argv[1]) == "positions")
+    {
+        Config config;
+        return Position_analysis(&config).run(argc > 2 ? argv[2] : "");
+    }
+    // Консольный режим: доказательство выигрыша, проигрыша или ничьей в позиции FEN
+    if (argc > 1 && string(argv[1]) == "solve")
+    {
+        Config config;
+        return Position_solver(&config).run(argc > 2 ? argv[2] : "", argc > 3 ? argv[3] : "");
+    }
+    // Консольный режим: подбор весов оценки по файлу позиций
+    if (argc > 1 && string(argv[1]) == "tune")
+    {
+        Config config;
+        return Tuner(&config).run(argc > 2 ? argv[2] : "");
+    }
+    // Консольный режим: обучение сети оценки по файлу позиций
+    if (argc > 1 && string(argv[1]) == "train")
+    {
+        Config config;
+        return Network_trainer(&config).run(argc > 2 ? argv[2] : "");
+    }
+#ifndef _WIN32
+    // Консольный режим: сервер множества партий на сокете домена Unix
+    if (argc > 1 && string(argv[1]) == "server")
+    {
+        Config config;
+        return Server(&config).run(argc > 2 ? argv[2] : "");
+    }
+#endif
+
+    // Консольный режим: матч двух движков с последовательным тестом SPRT
+    if (argc > 1 && string(argv[1]) == "match")
+    {
+        Config config;
+        return Match(&config).run();
+    }
+
     Game g;
     g.play();
 